@@ -0,0 +1,193 @@
+///	@file
+///	@brief		Main entry of benchmark.
+///	@details	Measures throughput and latency of logging.
+///				Each result is dumped as a line of JSON so that it can be compared between releases.
+///	@pre		ISO/IEC 14882:2017
+///	@author		Mura
+///	@copyright	(C) 2023-, Mura. All rights reserved.
+
+#include <xxx/config.hxx>
+#include <xxx/exceptions.hxx>
+#include <xxx/logger.hxx>
+#include <xxx/xxx.hxx>
+
+#include <string_view>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/// @brief	Gets the usage of this program.
+/// @param[in]	result		Result of this program. Zero means success. Negative value means an error.
+/// @return		String of the usage.
+std::string
+get_usage(int result = 0) {
+	if (0 < result) {
+		return "xxx benchmark\n (c) 2023-, Mura."
+			   "\n[Usage] $ ./bench  {options}"
+			   "\n[Options]"
+			   "\n  -h,--help   : Shows this usage."
+			   "\n  -n:count    : Calls per thread. (default: 100000)"
+			   "\n  -t:threads  : The maximum number of threads. (default: hardware concurrency)"
+			   "\n  -s:sink     : Sink to measure; console, file or syslog. It can be repeated. (default: file)"
+			   "\n  -o:path     : Writes results to the path instead of standard output.";
+	} else {
+		return "xxx benchmark\n (c) 2023-, Mura.\n\nAn error occurred.";
+	}
+}
+
+/// @brief	Result of a benchmark.
+struct result_t {
+	std::string_view		   name;		  ///< Name of the benchmark.
+	std::string_view		   sink;		  ///< Sink, or empty if no sink is used.
+	unsigned				   threads;		  ///< The number of threads.
+	std::uint64_t			   calls;		  ///< The number of calls in total.
+	std::chrono::nanoseconds   elapsed;		  ///< Elapsed time in wall clock.
+	std::vector<std::uint64_t> latencies;	  ///< Latency of each call in nanoseconds.
+};
+
+/// @brief	Dumps the result as a line of JSON.
+/// @param[in,out]	os		Output stream.
+/// @param[in]		result	Result to dump.
+void dump(std::ostream& os, result_t& result) {
+	auto const percentile = [&result](double p) -> std::uint64_t {
+		if (result.latencies.empty()) return 0u;
+		auto const n = static_cast<std::size_t>(p * static_cast<double>(result.latencies.size() - 1u));
+		std::nth_element(result.latencies.begin(), result.latencies.begin() + static_cast<std::ptrdiff_t>(n), result.latencies.end());
+		return result.latencies[n];
+	};
+	auto const seconds = std::chrono::duration<double>(result.elapsed).count();
+
+	os << "{\"benchmark\":\"" << result.name << "\""
+	   << ",\"sink\":\"" << result.sink << "\""
+	   << ",\"threads\":" << result.threads
+	   << ",\"calls\":" << result.calls
+	   << ",\"elapsed_ns\":" << result.elapsed.count()
+	   << ",\"calls_per_sec\":" << static_cast<std::uint64_t>(0.0 < seconds ? static_cast<double>(result.calls) / seconds : 0.0)
+	   << ",\"p50_ns\":" << percentile(0.5)
+	   << ",\"p99_ns\":" << percentile(0.99)
+	   << ",\"p999_ns\":" << percentile(0.999)
+	   << "}" << std::endl;
+}
+
+/// @brief	Calls the procedure on each thread and measures latency of each call.
+/// @param[in]	name		Name of the benchmark.
+/// @param[in]	sink		Sink.
+/// @param[in]	threads		The number of threads.
+/// @param[in]	count		Calls per thread.
+/// @param[in]	procedure	Procedure to measure.
+/// @return		Result of the benchmark.
+result_t measure(std::string_view name, std::string_view sink, unsigned threads, std::uint64_t count, std::function<void(std::uint64_t)> const& procedure) {
+	std::vector<std::vector<std::uint64_t>> latencies(threads);
+	for (auto& l: latencies) l.resize(static_cast<std::size_t>(count));
+
+	auto const begin = std::chrono::steady_clock::now();
+	{
+		std::vector<std::jthread> workers;
+		for (unsigned t{}; t < threads; ++t) {
+			workers.emplace_back([&procedure, &l = latencies[t], count]() {
+				for (std::uint64_t i{}; i < count; ++i) {
+					auto const b = std::chrono::steady_clock::now();
+					procedure(i);
+					auto const e = std::chrono::steady_clock::now();
+					l[static_cast<std::size_t>(i)] = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(e - b).count());
+				}
+			});
+		}
+	}
+	auto const end = std::chrono::steady_clock::now();
+
+	result_t result{name, sink, threads, count * threads, std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin), {}};
+	result.latencies.reserve(static_cast<std::size_t>(count * threads));
+	for (auto const& l: latencies) result.latencies.insert(result.latencies.end(), l.begin(), l.end());
+	return result;
+}
+
+static char const Unexpected[]{"Unexpected exception occurred"};
+}	 // namespace
+
+int main(int ac, char** av) {
+	try {
+		xxx::initialize_cpp();
+
+		auto const [result, options] = xxx::config::get_options(ac, av);
+		if (result != 0) {
+			std::clog << get_usage(result) << std::endl;
+			return result;
+		}
+
+		xxx::config::configurations_t const configurations{options};
+
+		auto const count	   = configurations.get_as<std::uint64_t>("n", 100000u);
+		auto const max_threads = std::max(1u, configurations.get_as<unsigned>("t", std::thread::hardware_concurrency()));
+		auto const sinks	   = options.contains("s") ? options.at("s") : std::vector<std::string>{"file"};
+
+		std::ofstream ofs;
+		if (options.contains("o")) {
+			ofs.exceptions(std::ios::badbit | std::ios::failbit);
+			ofs.open(options.at("o").at(0));
+		}
+		std::ostream& os = ofs.is_open() ? ofs : std::cout;
+
+		// Formatting without any sink.
+		{
+			auto r = measure("cat", "", 1u, count, [](std::uint64_t i) { [[maybe_unused]] auto const s = xxx::log::cat("value:", i, ", name:", "bench"); });
+			dump(os, r);
+		}
+		{
+			auto r = measure("enclose", "", 1u, count, [](std::uint64_t i) { [[maybe_unused]] auto const s = xxx::log::enclose(i, "bench", 1.5); });
+			dump(os, r);
+		}
+
+		std::filesystem::path const path{"bench.log"};
+		xxx::log::add_logger("bench", xxx::log::level_t::Info, "", "", false);
+		auto& logger = xxx::log::logger("bench");
+
+		for (auto const& sink: sinks) {
+			logger.set_console(sink == "console");
+			logger.set_path(sink == "file" ? path : std::filesystem::path{});
+			logger.set_logger(sink == "syslog" ? "xxx-bench" : "");
+			if (sink != "console" && sink != "file" && sink != "syslog") {
+				std::clog << get_usage(1) << std::endl;
+				return 1;
+			}
+
+			// Filtered-out calls do not reach any sink.
+			{
+				auto r = measure("filtered", sink, 1u, count, [&logger](std::uint64_t) { logger.debug("filtered"); });
+				dump(os, r);
+			}
+			for (unsigned threads{1u}; threads <= max_threads; threads *= 2u) {
+				auto r = measure("log", sink, threads, count, [&logger](std::uint64_t i) { logger.info(xxx::log::cat("value:", i)); });
+				dump(os, r);
+			}
+
+			logger.set_path("");
+			if (std::filesystem::exists(path)) {
+				std::filesystem::remove(path);
+			}
+		}
+		xxx::log::remove_logger("bench");
+
+		return 0;
+	} catch (std::exception const& e) {
+		xxx::suppress_exceptions([&e]() {
+			std::clog << xxx::log::enclose(Unexpected, e.what()) << std::endl;
+		});
+	} catch (...) {
+		xxx::suppress_exceptions([]() {
+			std::clog << Unexpected << std::endl;
+		});
+	}
+	return -1;
+}
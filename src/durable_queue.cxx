@@ -0,0 +1,470 @@
+///	@file
+///	@brief		xxx common library.
+///	@details	Event queue persisted in memory-mapped files.
+///	@pre		ISO/IEC 14882:2020 or higher
+///	@author		Mura
+///	@copyright	(C) 2023-, Mura. All rights reserved. (MIT License)
+
+#include <xxx/durable_queue.hxx>
+#include <xxx/exceptions.hxx>
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <system_error>
+#include <utility>
+
+#if defined(xxx_standard_cpp_only)
+#include <fstream>
+#elif defined(xxx_win32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define STRICT
+#include <Windows.h>
+#elif defined(xxx_posix)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#error "No platform is specified."
+#endif
+
+namespace xxx {
+
+namespace {
+
+///	@brief	Header of a record.
+struct header_t {
+	std::uint32_t size;		  ///< Size of the event, or end_of_segment.
+	std::uint32_t checksum;	  ///< Checksum of the size and the event.
+};
+
+///	@brief	Consumer offset.
+struct offset_t {
+	std::uint64_t segment;	   ///< Number of the segment.
+	std::uint64_t position;	   ///< Offset in the segment.
+};
+
+constexpr std::uint32_t end_of_segment{std::numeric_limits<std::uint32_t>::max()};	  ///< Size of the record which closes a segment.
+constexpr std::size_t	max_spares{2u};												  ///< The maximum number of segment files to recycle.
+
+// Aligns a size to records.
+constexpr std::size_t align_(std::size_t size) noexcept {
+	return (size + alignof(std::uint64_t) - 1u) & ~(alignof(std::uint64_t) - 1u);
+}
+
+// Calculates FNV-1a seeded with the number of the segment,
+// so that records left in a recycled segment are never valid.
+std::uint32_t checksum_(std::uint64_t number, std::uint32_t size, std::byte const* event) noexcept {
+	auto	   hash = static_cast<std::uint32_t>(2166136261u ^ number ^ (number >> 32u));
+	auto const step = [&hash](std::uint32_t byte) noexcept { hash = (hash ^ byte) * 16777619u; };
+	for (auto shift = 0u; shift < 32u; shift += 8u) {
+		step((size >> shift) & 0xffu);
+	}
+	if (size != end_of_segment) {
+		for (std::size_t i{}; i < size; ++i) {
+			step(std::to_integer<std::uint32_t>(event[i]));
+		}
+	}
+	return hash;
+}
+
+// Gets the size of the valid record at the position, or nullopt.
+std::optional<std::uint32_t> parse_(std::byte const* data, std::size_t length, std::uint64_t number, std::size_t position) noexcept {
+	if (length < position + sizeof(header_t)) return std::nullopt;
+	header_t header;
+	std::memcpy(&header, data + position, sizeof(header));
+	if (header.size != end_of_segment && length < position + sizeof(header_t) + align_(header.size)) return std::nullopt;
+	if (header.checksum != checksum_(number, header.size, data + position + sizeof(header_t))) return std::nullopt;
+	return header.size;
+}
+
+// Throws the last error of the system.
+[[noreturn]] void throw_system_error_(std::filesystem::path const& path) {
+#if defined(xxx_standard_cpp_only)
+	throw std::system_error{std::make_error_code(std::errc::io_error), path.string()};
+#elif defined(xxx_win32)
+	throw std::system_error{std::error_code{static_cast<int>(::GetLastError()), std::system_category()}, path.string()};
+#elif defined(xxx_posix)
+	throw std::system_error{std::error_code{errno, std::system_category()}, path.string()};
+#endif
+}
+
+}	 // namespace
+
+///	@brief	File mapped onto memory.
+class durable_queue_t::segment_t {
+public:
+	///	@brief	Gets the memory.
+	///	@return		The memory.
+	std::byte* data() const noexcept { return data_; }
+	///	@brief	Gets the size.
+	///	@return		Size of the file in bytes.
+	std::size_t size() const noexcept { return size_; }
+	///	@brief	Flushes a range of the memory to the storage.
+	///	@param[in]	offset	Offset of the range.
+	///	@param[in]	length	Length of the range.
+	void flush(std::size_t offset, std::size_t length) {
+		if (length == 0u) return;
+#if defined(xxx_standard_cpp_only)
+		file_.seekp(static_cast<std::streamoff>(offset));
+		file_.write(reinterpret_cast<char const*>(data_ + offset), static_cast<std::streamsize>(length));
+		if (! file_.flush()) throw_system_error_(path_);
+#elif defined(xxx_win32)
+		if (! ::FlushViewOfFile(data_ + offset, length) || ! ::FlushFileBuffers(file_)) throw_system_error_(path_);
+#elif defined(xxx_posix)
+		// The msync requires the address aligned to pages.
+		static auto const page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+		auto const		  begin = offset / page * page;
+		if (::msync(data_ + begin, offset + length - begin, MS_SYNC) != 0) throw_system_error_(path_);
+#endif
+	}
+
+	///	@brief	Constructor.
+	///		It creates the file if it does not exist, and extends it to the size.
+	///	@param[in]	path	Path of the file.
+	///	@param[in]	size	The minimum size of the file.
+	segment_t(std::filesystem::path path, std::size_t size) :
+		path_{std::move(path)}, data_{}, size_{} {
+		try {
+			open_(size);
+		} catch (...) {
+			close_();
+			throw;
+		}
+	}
+	///	@brief	Destructor.
+	~segment_t() noexcept { close_(); }
+
+private:
+	segment_t(segment_t const&)			   = delete;
+	segment_t& operator=(segment_t const&) = delete;
+
+	void open_(std::size_t size) {
+#if defined(xxx_standard_cpp_only)
+		if (! std::filesystem::exists(path_)) std::ofstream{path_, std::ios::binary};
+		size_ = std::max(size, static_cast<std::size_t>(std::filesystem::file_size(path_)));
+		std::filesystem::resize_file(path_, size_);
+		buffer_.resize(size_);
+		data_ = buffer_.data();
+		file_.open(path_, std::ios::in | std::ios::out | std::ios::binary);
+		if (! file_.read(reinterpret_cast<char*>(data_), static_cast<std::streamsize>(size_))) throw_system_error_(path_);
+#elif defined(xxx_win32)
+		file_ = ::CreateFileW(path_.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file_ == INVALID_HANDLE_VALUE) throw_system_error_(path_);
+		LARGE_INTEGER current{};
+		if (! ::GetFileSizeEx(file_, &current)) throw_system_error_(path_);
+		size_ = std::max(size, static_cast<std::size_t>(current.QuadPart));
+
+		// The mapping extends the file to the size.
+		auto const high = static_cast<DWORD>(static_cast<std::uint64_t>(size_) >> 32u);
+		auto const low	= static_cast<DWORD>(size_ & 0xffffffffu);
+		mapping_		= ::CreateFileMappingW(file_, nullptr, PAGE_READWRITE, high, low, nullptr);
+		if (! mapping_) throw_system_error_(path_);
+		data_ = static_cast<std::byte*>(::MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, size_));
+		if (! data_) throw_system_error_(path_);
+#elif defined(xxx_posix)
+		fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+		if (fd_ < 0) throw_system_error_(path_);
+		struct ::stat st{};
+		if (::fstat(fd_, &st) != 0) throw_system_error_(path_);
+		size_ = std::max(size, static_cast<std::size_t>(st.st_size));
+		if (static_cast<std::size_t>(st.st_size) < size_ && ::ftruncate(fd_, static_cast<::off_t>(size_)) != 0) throw_system_error_(path_);
+
+		auto* const p = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+		if (p == MAP_FAILED) throw_system_error_(path_);
+		data_ = static_cast<std::byte*>(p);
+		// Both of the producers and the consumers go through the file.
+		::madvise(p, size_, MADV_SEQUENTIAL);
+#endif
+	}
+	void close_() noexcept {
+#if defined(xxx_standard_cpp_only)
+		data_ = nullptr;
+#elif defined(xxx_win32)
+		if (data_) ::UnmapViewOfFile(std::exchange(data_, nullptr));
+		if (mapping_) ::CloseHandle(std::exchange(mapping_, nullptr));
+		if (file_ != INVALID_HANDLE_VALUE) ::CloseHandle(std::exchange(file_, INVALID_HANDLE_VALUE));
+#elif defined(xxx_posix)
+		if (data_) ::munmap(std::exchange(data_, nullptr), size_);
+		if (0 <= fd_) ::close(std::exchange(fd_, -1));
+#endif
+	}
+
+	std::filesystem::path const path_;			  ///< Path of the file.
+	std::byte*					data_;			  ///< The memory.
+	std::size_t					size_;			  ///< Size of the file.
+#if defined(xxx_standard_cpp_only)
+	std::vector<std::byte> buffer_{};			  ///< Contents of the file.
+	std::fstream		   file_{};				  ///< The file.
+#elif defined(xxx_win32)
+	HANDLE file_{INVALID_HANDLE_VALUE};			  ///< The file.
+	HANDLE mapping_{};							  ///< The mapping of the file.
+#elif defined(xxx_posix)
+	int fd_{-1};								  ///< The file.
+#endif
+};
+
+durable_queue_t::durable_queue_t(std::filesystem::path directory, std::size_t segment_size, std::chrono::milliseconds interval) :
+	directory_{std::move(directory)}, segment_size_{segment_size}, interval_{interval}, mutex_{}, condition_{}, committer_{}, committed_{}, offset_{}, head_{}, head_number_{}, read_{}, tail_{}, tail_number_{}, write_{}, flushed_{}, sealed_{}, retired_{}, spares_{}, count_{}, generation_{}, synced_{}, attempts_{}, error_{}, dirty_{}, urgent_{}, finished_{}, thread_{} {
+	validate_argument(sizeof(header_t) * 4u <= segment_size && segment_size % align_(1u) == 0u);
+	open_();
+	thread_ = std::thread{[this]() { run_(); }};
+}
+
+durable_queue_t::~durable_queue_t() noexcept {
+	terminate();
+}
+
+bool durable_queue_t::enqueue(std::string_view event) {
+	auto const record = sizeof(header_t) + align_(event.size());
+	validate_argument(event.size() < end_of_segment && record + sizeof(header_t) <= segment_size_, "too large event");
+
+	std::lock_guard lock{mutex_};
+	if (finished_) return false;
+	if (tail_->size() < write_ + record + sizeof(header_t)) {
+		// Closes the segment with a record of the end, which always has room.
+		auto next = acquire_(tail_number_ + 1u);
+		sealed_.reserve(sealed_.size() + 1u);
+		header_t const end{end_of_segment, checksum_(tail_number_, end_of_segment, nullptr)};
+		std::memcpy(tail_->data() + write_, &end, sizeof(end));
+		sealed_.emplace_back(std::move(tail_), flushed_);
+		tail_		 = std::move(next);
+		tail_number_ = tail_number_ + 1u;
+		write_		 = 0u;
+		flushed_	 = 0u;
+	}
+
+	// Writes the header after the event.
+	auto* const p = tail_->data() + write_;
+	std::memcpy(p + sizeof(header_t), event.data(), event.size());
+	auto const	   size = static_cast<std::uint32_t>(event.size());
+	header_t const header{size, checksum_(tail_number_, size, p + sizeof(header_t))};
+	std::memcpy(p, &header, sizeof(header));
+	write_ += record;
+	++count_;
+
+	if (! std::exchange(dirty_, true)) committer_.notify_one();
+	condition_.notify_one();
+	return true;
+}
+
+bool durable_queue_t::dequeue(std::string& event) {
+	std::unique_lock lock{mutex_};
+	condition_.wait(lock, [this]() { return 0u < count_ || finished_.load(); });
+	if (finished_) return false;
+	pop_(event);
+	return true;
+}
+
+bool durable_queue_t::try_dequeue(std::string& event) {
+	std::lock_guard lock{mutex_};
+	if (finished_ || count_ == 0u) return false;
+	pop_(event);
+	return true;
+}
+
+void durable_queue_t::commit() {
+	std::unique_lock lock{mutex_};
+	// Waits for the next commit if anything is updated, or for the commit in progress.
+	auto const generation = dirty_ ? generation_ + 1u : generation_;
+	if (generation <= synced_) return;
+	urgent_ = true;
+	committer_.notify_one();
+	auto const attempts = attempts_;
+	committed_.wait(lock, [this, generation, attempts]() { return generation <= synced_ || (attempts != attempts_ && error_) || finished_.load(); });
+	if (synced_ < generation && error_) throw std::system_error{error_, "commit"};
+}
+
+void durable_queue_t::terminate() noexcept {
+	{
+		std::lock_guard lock{mutex_};
+		finished_.store(true);
+	}
+	condition_.notify_all();
+	committer_.notify_all();
+	committed_.notify_all();
+	if (thread_.joinable() && thread_.get_id() != std::this_thread::get_id()) {
+		thread_.join();
+	}
+}
+
+std::size_t durable_queue_t::size() const noexcept {
+	std::lock_guard lock{mutex_};
+	return count_;
+}
+
+void durable_queue_t::open_() {
+	std::filesystem::create_directories(directory_);
+	offset_ = std::make_unique<segment_t>(directory_ / "offset", sizeof(offset_t));
+	offset_t offset;
+	std::memcpy(&offset, offset_->data(), sizeof(offset));
+
+	std::vector<std::uint64_t> numbers;
+	for (auto const& entry: std::filesystem::directory_iterator{directory_}) {
+		if (entry.path().extension() != ".seg") continue;
+		auto const	  stem = entry.path().stem().string();
+		std::uint64_t number{};
+		if (auto const [p, ec] = std::from_chars(stem.data(), stem.data() + stem.size(), number); ec == std::errc{} && p == stem.data() + stem.size()) {
+			numbers.push_back(number);
+		}
+	}
+	std::ranges::sort(numbers);
+
+	// The segments before the consumer offset have been dequeued.
+	head_number_	= offset.segment;
+	read_			= static_cast<std::size_t>(offset.position);
+	auto const live = std::ranges::lower_bound(numbers, head_number_);
+	std::for_each(numbers.begin(), live, [this](std::uint64_t number) { recycle_(number); });
+	if (live == numbers.end() || *live != head_number_) {
+		// The segment was recycled before the offset was flushed.
+		if (live != numbers.end()) head_number_ = *live;
+		read_ = 0u;
+	}
+	head_ = live != numbers.end() ? std::make_shared<segment_t>(get_path_(head_number_), segment_size_) : acquire_(head_number_);
+	if (read_ % align_(1u) != 0u || head_->size() < read_ + sizeof(header_t)) read_ = 0u;
+
+	// Scans the records sequentially to count the events and to find the end of the log.
+	auto segment  = head_;
+	auto number	  = head_number_;
+	auto position = read_;
+	while (auto const size = parse_(segment->data(), segment->size(), number, position)) {
+		if (*size != end_of_segment) {
+			++count_;
+			position += sizeof(header_t) + align_(*size);
+			continue;
+		}
+		++number;
+		position = 0u;
+		segment	 = std::ranges::binary_search(numbers, number) ? std::make_shared<segment_t>(get_path_(number), segment_size_) : acquire_(number);
+	}
+	tail_		 = std::move(segment);
+	tail_number_ = number;
+	write_		 = position;
+	flushed_	 = position;
+
+	// The segments after the end are left by a crash.
+	std::for_each(std::ranges::upper_bound(numbers, tail_number_), numbers.end(), [this](std::uint64_t number) { recycle_(number); });
+	dirty_ = true;
+}
+
+std::shared_ptr<durable_queue_t::segment_t> durable_queue_t::acquire_(std::uint64_t number) {
+	auto const path = get_path_(number);
+	if (! spares_.empty()) {
+		std::filesystem::rename(spares_.back(), path);
+		spares_.pop_back();
+	}
+	return std::make_shared<segment_t>(path, segment_size_);
+}
+
+void durable_queue_t::recycle_(std::uint64_t number) noexcept {
+	ignore_exceptions([this, number]() {
+		auto path = get_path_(number);
+		if (spares_.size() < max_spares) {
+			spares_.push_back(std::move(path));
+		} else {
+			std::filesystem::remove(path);
+		}
+	});
+}
+
+void durable_queue_t::pop_(std::string& event) {
+	header_t header;
+	std::memcpy(&header, head_->data() + read_, sizeof(header));
+	if (header.size == end_of_segment) {
+		// Goes to the next segment, and recycles this one after the offset is flushed.
+		auto const number = head_number_ + 1u;
+		auto	   next	  = number == tail_number_ ? tail_ : std::make_shared<segment_t>(get_path_(number), segment_size_);
+		retired_.push_back(head_number_);
+		head_		 = std::move(next);
+		head_number_ = number;
+		read_		 = 0u;
+		std::memcpy(&header, head_->data(), sizeof(header));
+	}
+	event.assign(reinterpret_cast<char const*>(head_->data() + read_ + sizeof(header_t)), header.size);	   // might cause an exception.
+	read_ += sizeof(header_t) + align_(header.size);
+	--count_;
+	if (! std::exchange(dirty_, true)) committer_.notify_one();
+}
+
+void durable_queue_t::run_() noexcept {
+	std::unique_lock lock{mutex_};
+	while (! finished_ || dirty_) {
+		if (! dirty_) {
+			committer_.wait(lock, [this]() { return dirty_ || finished_.load(); });
+			continue;
+		}
+		// Gathers updates into a group.
+		if (! urgent_ && ! finished_) {
+			committer_.wait_for(lock, interval_, [this]() { return urgent_ || finished_.load(); });
+		}
+		// If the storage keeps failing, the events left are flushed by the next run.
+		if (! commit_(lock) && finished_) break;
+	}
+}
+
+bool durable_queue_t::commit_(std::unique_lock<std::mutex>& lock) {
+	auto		   sealed	= std::exchange(sealed_, {});
+	auto		   retired	= std::exchange(retired_, {});
+	auto const	   tail		= tail_;
+	auto const	   from		= flushed_;
+	auto const	   to		= write_;
+	auto const	   generation = ++generation_;
+	offset_t const offset{head_number_, read_};
+	std::memcpy(offset_->data(), &offset, sizeof(offset));	  // Only the committer writes it.
+	dirty_	= false;
+	urgent_ = false;
+	lock.unlock();
+
+	// The events are flushed before the offset, and both of them before recycling segments.
+	std::error_code error;
+	try {
+		for (auto const& [segment, flushed]: sealed) {
+			segment->flush(flushed, segment->size() - flushed);
+		}
+		tail->flush(from, to - from);
+		offset_->flush(0u, sizeof(offset_t));
+	} catch (std::system_error const& e) {
+		error = e.code();
+	} catch (...) {
+		error = std::make_error_code(std::errc::io_error);
+	}
+
+	lock.lock();
+	++attempts_;
+	error_ = error;
+	if (error) {
+		// Keeps the segments to flush and to recycle for the next commit.
+		ignore_exceptions([this, &sealed, &retired]() {
+			sealed_.insert(sealed_.begin(), std::make_move_iterator(sealed.begin()), std::make_move_iterator(sealed.end()));
+			retired_.insert(retired_.begin(), retired.begin(), retired.end());
+		});
+		dirty_ = true;
+		committed_.notify_all();
+		return false;
+	}
+	sealed.clear();
+	if (tail == tail_) flushed_ = std::max(flushed_, to);
+	synced_ = generation;
+	for (auto const number: retired) {
+		recycle_(number);
+	}
+	committed_.notify_all();
+	return true;
+}
+
+std::filesystem::path durable_queue_t::get_path_(std::uint64_t number) const {
+	auto name = std::to_string(number);
+	name.insert(0u, std::numeric_limits<std::uint64_t>::digits10 + 1u - name.size(), '0');
+	return directory_ / (name + ".seg");
+}
+
+}	 // namespace xxx
@@ -0,0 +1,211 @@
+///	@file
+///	@brief		xxx common library.
+///	@details	Thread pool executing tasks with work stealing.
+///	@pre		ISO/IEC 14882:2020 or higher
+///	@author		Mura
+///	@copyright	(C) 2023-, Mura. All rights reserved. (MIT License)
+
+#include <xxx/exceptions.hxx>
+#include <xxx/executor.hxx>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#if defined(xxx_standard_cpp_only)
+
+#elif defined(xxx_win32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define STRICT
+#include <Windows.h>
+#elif defined(xxx_posix)
+#include <pthread.h>
+#include <sched.h>
+#else
+#error "No platform is specified."
+#endif
+
+namespace xxx {
+
+namespace {
+
+// Executor and index of the worker running on the current thread.
+thread_local executor_t const* executor_s{};
+thread_local std::size_t	   index_s{};
+
+// The number of failures to steal tasks before parking.
+constexpr std::size_t max_misses{64u};
+
+// Pins the current thread to a CPU.
+void pin_(std::size_t index) noexcept {
+	auto const cpus = std::max(1u, std::thread::hardware_concurrency());
+#if defined(xxx_standard_cpp_only)
+	static_cast<void>(index);
+	static_cast<void>(cpus);
+#elif defined(xxx_win32)
+	::SetThreadAffinityMask(::GetCurrentThread(), DWORD_PTR{1u} << (index % cpus % (sizeof(DWORD_PTR) * 8u)));
+#elif defined(xxx_posix) && defined(__linux__)
+	::cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(index % cpus, &set);
+	::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+#else
+	// unsupported platform.
+	static_cast<void>(index);
+	static_cast<void>(cpus);
+#endif
+}
+
+}	 // namespace
+
+executor_t::executor_t(std::size_t threads, bool pinned) :
+	workers_{}, mutex_{}, tasks_{}, pending_{}, signal_{}, sleepers_{}, finished_{}, joined_{} {
+	if (threads == 0u) threads = std::max(1u, std::thread::hardware_concurrency());
+
+	workers_.reserve(threads);
+	for (std::size_t i{}; i < threads; ++i) {
+		workers_.emplace_back(std::make_unique<worker_t>());
+	}
+	try {
+		for (std::size_t i{}; i < threads; ++i) {
+			workers_[i]->thread = std::thread{[this, i, pinned]() { run_(i, pinned); }};
+		}
+	} catch (...) {
+		terminate();
+		throw;
+	}
+}
+
+executor_t::~executor_t() noexcept {
+	terminate();
+}
+
+bool executor_t::post(task_t task) {
+	if (executor_s == this) {
+		// Workers are alive until all the tasks are executed, even if terminated.
+		if (finished_.load()) return false;
+		auto&			worker = *workers_[index_s];
+		std::lock_guard lock{worker.mutex};
+		worker.tasks.emplace_back(std::move(task));
+		pending_.fetch_add(1u);
+	} else {
+		// The flag is set under the lock, so that workers never miss this task.
+		std::lock_guard lock{mutex_};
+		if (finished_.load()) return false;
+		tasks_.emplace_back(std::move(task));
+		pending_.fetch_add(1u);
+	}
+	wake_();
+	return true;
+}
+
+void executor_t::terminate() noexcept {
+	{
+		std::lock_guard lock{mutex_};
+		finished_.store(true);
+	}
+	signal_.fetch_add(1u);
+	signal_.notify_all();
+
+	// A worker cannot wait for itself, so that the workers are joined later by another thread.
+	if (executor_s == this) return;
+	std::call_once(joined_, [this]() {
+		for (auto& worker: workers_) {
+			if (worker->thread.joinable()) worker->thread.join();
+		}
+	});
+}
+
+void executor_t::run_(std::size_t index, bool pinned) noexcept {
+	executor_s = this;
+	index_s	   = index;
+	if (pinned) pin_(index);
+
+	for (std::size_t misses{};;) {
+		if (task_t task; take_(index, task)) {
+			misses = 0u;
+			ignore_exceptions(task);
+			continue;
+		}
+		if (finished_.load() && pending_.load() == 0u) break;
+
+		// Registers as a sleeper before checking tasks again,
+		// so that a poster surely sees the sleeper or this worker surely sees the task.
+		// The tasks pending might be locked by other workers, then it parks after failing to steal them several times.
+		auto const signal = signal_.load();
+		sleepers_.fetch_add(1u);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (finished_.load()) {
+			std::this_thread::yield();
+		} else if (pending_.load() == 0u || max_misses <= ++misses) {
+			misses = 0u;
+			signal_.wait(signal);
+		} else {
+			std::this_thread::yield();
+		}
+		sleepers_.fetch_sub(1u);
+	}
+}
+
+bool executor_t::run_one_() {
+	task_t task;
+	if (! take_(executor_s == this ? index_s : workers_.size(), task)) return false;
+	ignore_exceptions(task);
+	return true;
+}
+
+bool executor_t::take_(std::size_t index, task_t& task) {
+	if (pending_.load() == 0u) return false;
+
+	// Its own newest task.
+	if (index < workers_.size()) {
+		auto&			worker = *workers_[index];
+		std::lock_guard lock{worker.mutex};
+		if (! worker.tasks.empty()) {
+			task = std::move(worker.tasks.back());
+			worker.tasks.pop_back();
+			pending_.fetch_sub(1u);
+			return true;
+		}
+	}
+	// The oldest shared task.
+	{
+		std::lock_guard lock{mutex_};
+		if (! tasks_.empty()) {
+			task = std::move(tasks_.front());
+			tasks_.pop_front();
+			pending_.fetch_sub(1u);
+			return true;
+		}
+	}
+	// The oldest task of another worker.
+	for (std::size_t i{1u}; i <= workers_.size(); ++i) {
+		auto&			 worker = *workers_[(index + i) % workers_.size()];
+		std::unique_lock lock{worker.mutex, std::try_to_lock};
+		if (lock && ! worker.tasks.empty()) {
+			task = std::move(worker.tasks.front());
+			worker.tasks.pop_front();
+			pending_.fetch_sub(1u);
+			return true;
+		}
+	}
+	return false;
+}
+
+void executor_t::wake_() noexcept {
+	// Pairs with the fence of the sleeper.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (0u < sleepers_.load(std::memory_order_relaxed)) {
+		signal_.fetch_add(1u);
+		signal_.notify_one();
+	}
+}
+
+}	 // namespace xxx
@@ -0,0 +1,119 @@
+///	@file
+///	@brief		xxx common library.
+///	@details	Thread pool executing tasks in order of each key.
+///	@pre		ISO/IEC 14882:2020 or higher
+///	@author		Mura
+///	@copyright	(C) 2023-, Mura. All rights reserved. (MIT License)
+
+#include <xxx/exceptions.hxx>
+#include <xxx/keyed_executor.hxx>
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace xxx {
+
+namespace {
+
+// Executor of the worker running on the current thread.
+thread_local keyed_executor_t const* executor_s{};
+
+}	 // namespace
+
+keyed_executor_t::keyed_executor_t(std::size_t threads, std::size_t quantum) :
+	threads_{}, quantum_{std::max(quantum, std::size_t{1u})}, mutex_{}, condition_{}, strands_{}, ready_{}, finished_{}, joined_{} {
+	if (threads == 0u) threads = std::max(1u, std::thread::hardware_concurrency());
+
+	threads_.reserve(threads);
+	try {
+		for (std::size_t i{}; i < threads; ++i) {
+			threads_.emplace_back([this]() { run_(); });
+		}
+	} catch (...) {
+		terminate();
+		throw;
+	}
+}
+
+keyed_executor_t::~keyed_executor_t() noexcept {
+	terminate();
+}
+
+void keyed_executor_t::terminate() noexcept {
+	{
+		std::lock_guard lock{mutex_};
+		finished_.store(true);
+	}
+	condition_.notify_all();
+
+	// A worker cannot wait for itself, so that the workers are joined later by another thread.
+	if (executor_s == this) return;
+	std::call_once(joined_, [this]() {
+		for (auto& thread: threads_) {
+			if (thread.joinable()) thread.join();
+		}
+	});
+}
+
+bool keyed_executor_t::post_(std::size_t key, task_t task) {
+	{
+		std::lock_guard lock{mutex_};
+		if (finished_.load()) return false;
+		auto&	   strand = strands_[key];	  // might cause an exception.
+		auto const idle	  = strand.tasks.empty() && ! strand.running;
+		try {
+			strand.tasks.emplace_back(std::move(task));	   // might cause an exception.
+			if (idle) ready_.push_back(key);			   // might cause an exception.
+		} catch (...) {
+			// Rolls the new strand back, so that a strand is never left out of the run queue with tasks nor empty,
+			// which would keep the workers waiting for it forever.
+			if (idle) strands_.erase(key);
+			throw;
+		}
+	}
+	condition_.notify_one();
+	return true;
+}
+
+void keyed_executor_t::run_() noexcept {
+	executor_s = this;
+	std::vector<task_t> tasks;
+	tasks.reserve(quantum_);
+
+	std::unique_lock lock{mutex_};
+	for (;;) {
+		// Workers are alive until all the tasks are executed, even if terminated.
+		condition_.wait(lock, [this]() { return ! ready_.empty() || (finished_.load() && strands_.empty()); });
+		if (ready_.empty()) break;
+
+		auto const key = ready_.front();
+		ready_.pop_front();
+		auto& strand   = strands_.at(key);
+		strand.running = true;
+		auto const last = strand.tasks.begin() + static_cast<std::ptrdiff_t>(std::min(quantum_, strand.tasks.size()));
+		std::move(strand.tasks.begin(), last, std::back_inserter(tasks));
+		strand.tasks.erase(strand.tasks.begin(), last);
+
+		// The strand is never erased while it is running, so that the reference is still valid after executing the tasks.
+		lock.unlock();
+		for (auto& task: tasks) ignore_exceptions(task);
+		tasks.clear();
+		lock.lock();
+
+		strand.running = false;
+		if (strand.tasks.empty()) {
+			strands_.erase(key);
+			if (finished_.load() && strands_.empty()) condition_.notify_all();
+		} else {
+			// The strand goes back to the end, so that the other keys are executed before its next tasks.
+			ready_.push_back(key);
+			condition_.notify_one();
+		}
+	}
+}
+
+}	 // namespace xxx
@@ -5,20 +5,35 @@
 ///	@author		Mura
 ///	@copyright	(C) 2018-, Mura. All rights reserved. (MIT License)
 
+#include <xxx/db.hxx>
 #include <xxx/exceptions.hxx>
 #include <xxx/logger.hxx>
+#include <xxx/mpmc_queue.hxx>
 #include <xxx/xxx.hxx>
 
 #include <unordered_map>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <chrono>
+#include <condition_variable>
 #include <ctime>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <optional>
+#include <random>
 #include <regex>
 #include <thread>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 #if defined(xxx_standard_cpp_only)
 
@@ -37,6 +52,12 @@
 #error "No platform is specified."
 #endif
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && 2 <= _M_IX86_FP)
+#include <emmintrin.h>
+#endif
+
 //	@name	xxx
 namespace xxx {
 namespace log {
@@ -47,50 +68,721 @@ namespace {
 std::regex const function_name_re{R"((?:[-A-Za-z_0-9<>{}:,.]+ )*(?:`?[A-Za-z_<{][-A-Za-z_0-9<>{}'}]*::)*(~?[A-Za-z_][A-Za-z_0-9<>{} ]*) ?\(.*$)"};
 }
 
+// Gets the path of the time index beside the log file.
+std::filesystem::path
+get_index_path_(std::filesystem::path const& path) {
+	return std::filesystem::path{path}.concat(".idx");
+}
+
+// An entry of the time index; a pair of the timestamp in microseconds and the offset.
+using index_entry_t = std::array<std::int64_t, 2>;
+
+// Reads an entry of the time index.
+index_entry_t
+read_index_entry_(std::ifstream& ifs, std::uintmax_t n) {
+	index_entry_t entry;
+	ifs.seekg(static_cast<std::streamoff>(n * sizeof(entry)));
+	ifs.read(reinterpret_cast<char*>(entry.data()), sizeof(entry));
+	return entry;
+}
+
+// Finds the first entry of the time index whose timestamp is at the time or after by binary search,
+// where the records up to the entry before it are all before the time since the timestamps of the entries are the latest so far.
+std::uintmax_t
+search_index_(std::ifstream& ifs, std::uintmax_t entries, std::chrono::system_clock::time_point const& time) {
+	auto const us = std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+
+	std::uintmax_t lower{}, upper{entries};
+	while (lower < upper) {
+		auto const middle = lower + (upper - lower) / 2u;
+		if (read_index_entry_(ifs, middle)[0] < us) {
+			lower = middle + 1u;
+		} else {
+			upper = middle;
+		}
+	}
+	return lower;
+}
+
+// Validates the time index beside the log file of the size, and returns the last entry if any.
+// An index which does not match the log, such as the one left for a log recreated or rotated by others, is removed;
+// records before the following entries are found by reading the log from the head.
+// An incomplete entry at the tail is truncated, so that the following entries are aligned.
+std::optional<index_entry_t>
+validate_index_(std::filesystem::path const& path, std::uintmax_t size) {
+	auto const index = get_index_path_(path);
+	if (! std::filesystem::exists(index)) return std::nullopt;
+
+	auto const entries = std::filesystem::file_size(index) / sizeof(index_entry_t);
+	auto const matches = [&path, &index, size, entries]() -> std::optional<index_entry_t> {
+		if (entries == 0u) return std::nullopt;
+
+		// The record at the offset of the last entry begins at a line, and is timestamped up to the entry.
+		std::ifstream ifs{index, std::ios::binary};
+		auto const entry = read_index_entry_(ifs, entries - 1u);
+		if (! ifs || entry[1] < 0 || size <= static_cast<std::uintmax_t>(entry[1])) return std::nullopt;
+
+		std::ifstream log{path, std::ios::binary};
+		log.seekg(std::max<std::streamoff>(entry[1] - 1, 0));
+		if (0 < entry[1] && log.get() != '\n') return std::nullopt;
+		std::string line;
+		if (! std::getline(log, line)) return std::nullopt;
+		auto const time = parse_timestamp(line);
+		if (! time || entry[0] < std::chrono::duration_cast<std::chrono::microseconds>(time->time_since_epoch()).count()) return std::nullopt;
+		return entry;
+	}();
+	if (! matches) {
+		std::filesystem::remove(index);
+	} else if (std::filesystem::file_size(index) % sizeof(index_entry_t) != 0u) {
+		std::filesystem::resize_file(index, entries * sizeof(index_entry_t));
+	}
+	return matches;
+}
+
+namespace impl {
+
+///	@brief	SQLite sink of logs.
+///		Rows are inserted by a background thread in batches,
+///		each of which is wrapped in a transaction and reuses the same prepared statement.
+///		When the queue is full, new records are dropped and reported as a row,
+///		but Error or more severe records wait for room instead.
+class db_sink_t {
+public:
+	using dropped_t = std::function<record_t(std::size_t)>;	   ///< Makes a record to report dropped records.
+
+	///	@brief	Enqueues a record.
+	///		It does not wait for the database unless the record is Error or more severe and the queue is full.
+	///	@param[in]		record		Record to insert.
+	void insert(record_t const& record) {
+		std::optional<record_t> row{record};
+		if (queue_.try_enqueue(std::move(row))) return;
+		if (static_cast<int>(record.level) <= static_cast<int>(level_t::Error)) {
+			queue_.enqueue(std::move(row));
+		} else {
+			drops_.fetch_add(1u);
+		}
+	}
+
+	///	@brief	Constructor.
+	///	@param[in]		path		The path of database.
+	///	@param[in]		table		Table name.
+	///	@param[in]		capacity	The number of records to queue.
+	///	@param[in]		dropped		Makes a record to report dropped records.
+	db_sink_t(std::filesystem::path const& path, std::string_view const table, std::size_t capacity, dropped_t dropped) :
+		db_{path}, statement_{}, queue_{capacity}, dropped_{std::move(dropped)}, drops_{}, thread_{} {
+		validate_argument(std::regex_match(table.begin(), table.end(), std::regex{R"(^[A-Za-z_][A-Za-z_0-9]*$)"}));
+
+		auto const name{std::string{table}};
+		db_.execute("PRAGMA journal_mode=WAL");
+		db_.execute("CREATE TABLE IF NOT EXISTS " + name + " (timestamp INTEGER, level INTEGER, tid TEXT, file TEXT, line INTEGER, function TEXT, message TEXT)");
+		statement_.emplace(db_.prepare("INSERT INTO " + name + " (timestamp, level, tid, file, line, function, message) VALUES (?, ?, ?, ?, ?, ?, ?)"));
+		thread_ = std::thread{[this]() { run_(); }};
+	}
+	///	@brief	Destructor.
+	///		It stores all the enqueued rows before returning.
+	~db_sink_t() {
+		queue_.enqueue(std::nullopt);	 // sentinel
+		if (thread_.joinable()) thread_.join();
+	}
+
+private:
+	void run_() noexcept {
+		constexpr std::size_t Batch{256u};	  // It is a magic number.
+
+		std::vector<std::optional<record_t>> rows;
+		rows.reserve(Batch);
+		for (bool stopped{}; ! stopped;) {
+			rows.clear();
+			ignore_exceptions([&]() {
+				std::optional<record_t> row;
+				if (! queue_.dequeue(row)) return;
+				do {
+					rows.emplace_back(std::move(row));
+				} while (rows.size() < Batch && queue_.try_dequeue(row));
+			});
+			if (rows.empty()) break;
+
+			auto const last = std::find(rows.begin(), rows.end(), std::nullopt);
+			stopped			= last != rows.end();
+			ignore_exceptions([&]() {
+				db::sl3::transaction_t transaction{db_, db::sl3::transaction_type_t::Immediate};
+				std::for_each(rows.begin(), last, [this](auto const& row) { insert_(*row); });
+				if (auto const drops = drops_.exchange(0u); 0u < drops) insert_(dropped_(drops));
+				transaction.commit();
+			});
+		}
+	}
+	void insert_(record_t const& row) {
+		auto const timestamp = std::chrono::duration_cast<std::chrono::microseconds>(row.time.time_since_epoch()).count();
+		statement_->execute(static_cast<std::int64_t>(timestamp), row.level, row.tid, row.file, row.line, row.function, row.message);
+	}
+
+private:
+	db::sl3::db_t						  db_;			  ///< Database.
+	std::optional<db::sl3::statement_t>	  statement_;	  ///< Prepared statement to insert.
+	mpmc_queue<std::optional<record_t>>	  queue_;		  ///< Records to insert, or nullopt to stop.
+	dropped_t const						  dropped_;		  ///< Makes a record to report dropped records.
+	std::atomic<std::size_t>			  drops_;		  ///< The number of dropped records.
+	std::thread							  thread_;		  ///< Background thread.
+};
+
+///	@brief	Queued logging.
+///		Records are written by a background thread,
+///		and the overflow policy decides what happens when the queue is full.
+///		Spilled records are also written to and replayed from the spill file by the background thread,
+///		so that callers never wait for the file.
+class async_sink_t {
+public:
+	using writer_t	= std::function<void(record_t const&)>;	   ///< Writes a record to the sinks.
+	using dropped_t = std::function<record_t(std::size_t)>;	   ///< Makes a record to report dropped records.
+
+	///	@brief	Enqueues a record.
+	///	@param[in]		record		Record to write.
+	void push(record_t&& record) {
+		std::unique_lock lock{mutex_};
+		if (finished_) {
+			lock.unlock();
+			writer_(record);
+			return;
+		}
+		if (records_.size() < capacity_ && spilled_ == 0u) {
+			enqueue_(std::move(record));
+			return;
+		}
+		switch (overflow_) {
+		default: [[fallthrough]];
+		case overflow_t::Block:
+			wait_(lock);
+			enqueue_(std::move(record));
+			break;
+		case overflow_t::DropOldest: [[fallthrough]];
+		case overflow_t::DropNewest:
+			drop_(lock, std::move(record));
+			break;
+		case overflow_t::Spill:
+			// Overflowed records are also bounded until the background thread takes them,
+			// and severe records wait for room instead of being dropped.
+			if (spill_capacity_ <= spilling_.size()) {
+				if (level_t::Error < record.level) {
+					++drops_;
+					break;
+				}
+				not_full_.wait(lock, [this]() { return spilling_.size() < spill_capacity_ || finished_; });
+			}
+			spilling_.push_back(std::move(record));
+			++spilled_;
+			not_empty_.notify_one();
+			break;
+		}
+	}
+
+	///	@brief	Constructor.
+	///	@param[in]		capacity	The number of records to queue.
+	///	@param[in]		overflow	Overflow policy.
+	///	@param[in]		writer		Writes a record to the sinks.
+	///	@param[in]		dropped		Makes a record to report dropped records.
+	async_sink_t(std::size_t capacity, overflow_t overflow, writer_t writer, dropped_t dropped) :
+		capacity_{capacity}, spill_capacity_{std::max(capacity, min_spill_capacity)}, overflow_{overflow}, writer_{std::move(writer)}, dropped_{std::move(dropped)}, mutex_{}, not_empty_{}, not_full_{}, records_{}, levels_{}, drops_{}, spilling_{}, spilled_{}, finished_{}, spill_path_{}, spill_ofs_{}, stored_{}, thread_{} {
+		validate_argument(0u < capacity_);
+		thread_ = std::thread{[this]() { run_(); }};
+	}
+	///	@brief	Destructor.
+	///		It writes all the queued and spilled records before returning.
+	~async_sink_t() {
+		{
+			std::lock_guard lock{mutex_};
+			finished_ = true;
+		}
+		not_empty_.notify_all();
+		not_full_.notify_all();
+		if (thread_.joinable()) thread_.join();
+	}
+
+private:
+	static constexpr std::size_t fields_size		= 12u;		 ///< The number of integral fields of a spilled record.
+	static constexpr std::size_t min_spill_capacity = 65536u;	 ///< The minimum number of overflowed records to hold in memory.
+
+	///	@brief	Header of a spilled record, which is followed by the payload.
+	struct spill_header_t {
+		std::uint64_t size;		  ///< Size of the payload.
+		std::uint32_t checksum;	  ///< Checksum of the payload.
+	};
+
+	// Computes the FNV-1a hash of the payload.
+	static std::uint32_t checksum_(std::string const& payload) noexcept {
+		std::uint32_t hash{2166136261u};
+		for (auto const ch: payload) hash = (hash ^ static_cast<unsigned char>(ch)) * 16777619u;
+		return hash;
+	}
+
+	void enqueue_(record_t&& record) {
+		++levels_[static_cast<std::size_t>(record.level)];
+		records_.push_back(std::move(record));
+		not_empty_.notify_one();
+	}
+	void wait_(std::unique_lock<std::mutex>& lock) {
+		not_full_.wait(lock, [this]() { return records_.size() < capacity_ || finished_; });
+	}
+	void drop_(std::unique_lock<std::mutex>& lock, record_t&& record) {
+		// Sheds the least severe level first, but never Error or more severe.
+		auto least = static_cast<std::size_t>(record.level);
+		for (auto lv = levels_.size() - 1u; least < lv; --lv) {
+			if (0u < levels_[lv]) {
+				least = lv;
+				break;
+			}
+		}
+		if (least <= static_cast<std::size_t>(level_t::Error)) {
+			// Severe records wait for room instead, so that the queue is still bounded.
+			wait_(lock);
+			enqueue_(std::move(record));
+			return;
+		}
+		++drops_;
+		if (least == static_cast<std::size_t>(record.level) && (overflow_ == overflow_t::DropNewest || levels_[least] == 0u)) {
+			return;	   // Drops the new record.
+		}
+		auto const match = [least](auto const& r) { return static_cast<std::size_t>(r.level) == least; };
+		if (overflow_ == overflow_t::DropOldest) {
+			records_.erase(std::find_if(records_.begin(), records_.end(), match));
+		} else {
+			records_.erase(std::prev(std::find_if(records_.rbegin(), records_.rend(), match).base()));
+		}
+		--levels_[least];
+		enqueue_(std::move(record));
+	}
+	// Appends records to the spill file, and returns the number of records failed to append.
+	std::size_t spill_(std::deque<record_t> const& records) {
+		if (! spill_ofs_.is_open()) {
+			ignore_exceptions([this]() {
+				std::random_device rd;
+				spill_path_ = std::filesystem::temp_directory_path() / ("xxx-log-" + std::to_string(rd()) + "-" + std::to_string(rd()) + ".spill");
+				spill_ofs_.exceptions(std::ios::badbit | std::ios::failbit);
+				spill_ofs_.open(spill_path_, std::ios::trunc | std::ios::binary);
+			});
+			if (! spill_ofs_.is_open()) return records.size();
+		}
+
+		std::size_t lost{};
+		std::string payload;
+		for (auto const& record: records) {
+			auto stored = false;
+			ignore_exceptions([this, &record, &payload, &stored]() {
+				auto const put = [&payload](void const* data, std::size_t size) { payload.append(static_cast<char const*>(data), size); };
+				auto const put_string = [&put](std::string const& str) {
+					auto const size = static_cast<std::uint64_t>(str.size());
+					put(&size, sizeof(size));
+					put(str.data(), str.size());
+				};
+				std::int64_t const fields[fields_size]{
+					static_cast<std::int64_t>(record.level), record.time.time_since_epoch().count(), static_cast<std::int64_t>(record.line),
+					record.lt.tm_sec, record.lt.tm_min, record.lt.tm_hour, record.lt.tm_mday, record.lt.tm_mon, record.lt.tm_year, record.lt.tm_wday, record.lt.tm_yday, record.lt.tm_isdst};
+				payload.clear();
+				put(fields, sizeof(fields));
+				put_string(record.tid);
+				put_string(record.file);
+				put_string(record.function);
+				put_string(record.message);
+				put_string(record.text);
+
+				// A record torn by a failure is detected by its size and checksum on replay.
+				spill_header_t const header{payload.size(), checksum_(payload)};
+				spill_ofs_.write(reinterpret_cast<char const*>(&header), sizeof(header));
+				spill_ofs_.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+				stored = true;
+			});
+			if (stored) {
+				++stored_;
+			} else {
+				++lost;
+			}
+		}
+		return lost;
+	}
+	// Writes the records in the spill file and removes it, and returns the number of records failed to replay.
+	std::size_t replay_() {
+		std::size_t replayed{};
+		ignore_exceptions([this]() { spill_ofs_.close(); });
+		spill_ofs_.clear();
+		ignore_exceptions([this, &replayed]() {
+			auto const length = std::filesystem::file_size(spill_path_);
+			std::ifstream ifs;
+			ifs.open(spill_path_, std::ios::binary);
+
+			// Stops at the first torn or corrupted record, and the following records are lost.
+			std::string payload;
+			while (replayed < stored_) {
+				spill_header_t header{};
+				if (! ifs.read(reinterpret_cast<char*>(&header), sizeof(header)) || length < header.size) break;
+				payload.resize(static_cast<std::size_t>(header.size));
+				if (! ifs.read(payload.data(), static_cast<std::streamsize>(payload.size())) || header.checksum != checksum_(payload)) break;
+
+				std::size_t offset{};
+				auto const get = [&payload, &offset](void* data, std::size_t size) {
+					if (payload.size() - offset < size) return false;
+					std::copy_n(payload.data() + offset, size, static_cast<char*>(data));
+					offset += size;
+					return true;
+				};
+				auto const get_string = [&payload, &offset, &get](std::string& str) {
+					std::uint64_t size{};
+					if (! get(&size, sizeof(size)) || payload.size() - offset < size) return false;
+					str.assign(payload, offset, static_cast<std::size_t>(size));
+					offset += static_cast<std::size_t>(size);
+					return true;
+				};
+				std::int64_t fields[fields_size]{};
+				record_t	 record{};
+				if (! get(fields, sizeof(fields)) || ! get_string(record.tid) || ! get_string(record.file) || ! get_string(record.function) || ! get_string(record.message) || ! get_string(record.text)) break;
+
+				record.level = static_cast<level_t>(fields[0]);
+				record.time	 = std::chrono::system_clock::time_point{std::chrono::system_clock::duration{fields[1]}};
+				record.line	 = static_cast<std::uint_least32_t>(fields[2]);
+				record.lt	 = std::tm{};
+				int* const tm[]{&record.lt.tm_sec, &record.lt.tm_min, &record.lt.tm_hour, &record.lt.tm_mday, &record.lt.tm_mon, &record.lt.tm_year, &record.lt.tm_wday, &record.lt.tm_yday, &record.lt.tm_isdst};
+				for (std::size_t i{}; i < std::size(tm); ++i) *tm[i] = static_cast<int>(fields[3 + i]);
+				++replayed;
+				ignore_exceptions([this, &record]() { writer_(record); });
+			}
+		});
+		ignore_exceptions([this]() { std::filesystem::remove(spill_path_); });
+		spill_path_.clear();
+		return std::exchange(stored_, 0u) - replayed;
+	}
+	void run_() noexcept {
+		for (;;) {
+			std::deque<record_t> records, spilling;
+			std::size_t			 drops{};
+			auto				 replay = false;
+			{
+				std::unique_lock lock{mutex_};
+				not_empty_.wait(lock, [this]() { return ! records_.empty() || 0u < spilled_ || 0u < drops_ || finished_; });
+				if (records_.empty() && spilled_ == 0u && drops_ == 0u && finished_) break;
+
+				records.swap(records_);
+				spilling.swap(spilling_);
+				levels_.fill(0u);
+				drops = std::exchange(drops_, 0u);
+				if (records.empty() && 0u < spilled_) {
+					// Spilled records are newer than the queued ones, and older than the following ones.
+					replay	 = true;
+					spilled_ = 0u;
+				}
+			}
+			not_full_.notify_all();
+
+			for (auto const& record: records) ignore_exceptions([this, &record]() { writer_(record); });
+			if (replay) {
+				// Records which have not been spilled yet are newer than the spill file.
+				if (0u < stored_) drops += replay_();
+				for (auto const& record: spilling) ignore_exceptions([this, &record]() { writer_(record); });
+			} else if (! spilling.empty()) {
+				drops += spill_(spilling);
+			}
+			if (0u < drops) ignore_exceptions([this, drops]() { writer_(dropped_(drops)); });
+		}
+	}
+
+private:
+	std::size_t const		   capacity_;	   ///< The number of records to queue.
+	std::size_t const		   spill_capacity_;	///< The number of overflowed records to hold until the background thread takes them.
+	overflow_t const		   overflow_;	   ///< Overflow policy.
+	writer_t const			   writer_;		   ///< Writes a record to the sinks.
+	dropped_t const			   dropped_;	   ///< Makes a record to report dropped records.
+	std::mutex				   mutex_;		   ///< Mutex.
+	std::condition_variable	   not_empty_;	   ///< Condition to wait records.
+	std::condition_variable	   not_full_;	   ///< Condition to wait room.
+	std::deque<record_t>	   records_;	   ///< Queued records.
+	std::array<std::size_t, 10> levels_;	   ///< The number of queued records for each level.
+	std::size_t				   drops_;		   ///< The number of dropped records.
+	std::deque<record_t>	   spilling_;	   ///< Overflowed records to be spilled by the background thread.
+	std::size_t				   spilled_;	   ///< The number of overflowed records which have not been replayed.
+	bool					   finished_;	   ///< Finished flag.
+	std::filesystem::path	   spill_path_;	   ///< The path of spill file, which only the background thread uses.
+	std::ofstream			   spill_ofs_;	   ///< Spill file, which only the background thread uses.
+	std::size_t				   stored_;		   ///< The number of records in the spill file.
+	std::thread				   thread_;		   ///< Background thread.
+};
+
+namespace {
+
+inline bool
+needs_escape_(unsigned char ch, escape_t escape) noexcept {
+	return ch < 0x20 || ch == '"' || ch == '\\' || (escape == escape_t::Text && 0x7F <= ch);
+}
+
+}	 // namespace
+
+std::size_t
+find_escape_(char const* data, std::size_t size, escape_t escape) noexcept {
+	std::size_t i{};
+	// Signed comparison with the space matches both control characters and non-ASCII bytes at once.
+	// Non-ASCII bytes are excluded again for JSON, which accepts raw UTF-8.
+#if defined(__AVX2__)
+	{
+		auto const space = _mm256_set1_epi8(0x20);
+		auto const quote = _mm256_set1_epi8('"');
+		auto const slash = _mm256_set1_epi8('\\');
+		auto const del	 = _mm256_set1_epi8(0x7F);
+		auto const zero	 = _mm256_setzero_si256();
+		for (; i + 32u <= size; i += 32u) {
+			auto const v	= _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + i));
+			auto const ctrl = _mm256_cmpgt_epi8(space, v);
+			auto	   m	= _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, slash));
+			m				= escape == escape_t::Text
+								  ? _mm256_or_si256(m, _mm256_or_si256(ctrl, _mm256_cmpeq_epi8(v, del)))
+								  : _mm256_or_si256(m, _mm256_andnot_si256(_mm256_cmpgt_epi8(zero, v), ctrl));
+			if (auto const bits = static_cast<std::uint32_t>(_mm256_movemask_epi8(m)); bits != 0u) {
+				return i + static_cast<std::size_t>(std::countr_zero(bits));
+			}
+		}
+	}
+#endif
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && 2 <= _M_IX86_FP)
+	{
+		auto const space = _mm_set1_epi8(0x20);
+		auto const quote = _mm_set1_epi8('"');
+		auto const slash = _mm_set1_epi8('\\');
+		auto const del	 = _mm_set1_epi8(0x7F);
+		auto const zero	 = _mm_setzero_si128();
+		for (; i + 16u <= size; i += 16u) {
+			auto const v	= _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i));
+			auto const ctrl = _mm_cmplt_epi8(v, space);
+			auto	   m	= _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, slash));
+			m				= escape == escape_t::Text
+								  ? _mm_or_si128(m, _mm_or_si128(ctrl, _mm_cmpeq_epi8(v, del)))
+								  : _mm_or_si128(m, _mm_andnot_si128(_mm_cmplt_epi8(v, zero), ctrl));
+			if (auto const bits = static_cast<std::uint32_t>(_mm_movemask_epi8(m)); bits != 0u) {
+				return i + static_cast<std::size_t>(std::countr_zero(bits));
+			}
+		}
+	}
+#endif
+	for (; i < size; ++i) {
+		if (needs_escape_(static_cast<unsigned char>(data[i]), escape)) return i;
+	}
+	return size;
+}
+
+void escape_(std::ostream& os, std::string_view text, escape_t escape) {
+	char const Hex[]{"0123456789ABCDEF"};
+
+	while (! text.empty()) {
+		auto const n = find_escape_(text.data(), text.size(), escape);
+		if (0u < n) os.write(text.data(), static_cast<std::streamsize>(n));
+		if (n == text.size()) break;
+
+		auto const ch = static_cast<unsigned char>(text[n]);
+		switch (ch) {
+		case '"': os.write("\\\"", 2); break;
+		case '\\': os.write("\\\\", 2); break;
+		case '\n': os.write("\\n", 2); break;
+		case '\r': os.write("\\r", 2); break;
+		case '\t': os.write("\\t", 2); break;
+		default:
+			if (escape == escape_t::Json) {
+				char const u[]{'\\', 'u', '0', '0', Hex[ch >> 4], Hex[ch & 0x0F]};
+				os.write(u, sizeof(u));
+			} else {
+				char const x[]{'\\', 'x', Hex[ch >> 4], Hex[ch & 0x0F]};
+				os.write(x, sizeof(x));
+			}
+			break;
+		}
+		text.remove_prefix(n + 1u);
+	}
+}
+
+}	 // namespace impl
+
 logger_t::logger_t(level_t level, std::filesystem::path const& path, std::string_view const logger, bool console, bool daily) :
-	level_{level}, path_{}, logger_{logger}, console_{console}, daily_{}, ofs_{}, mutex_{}, file_mutex_{}, console_mutex_{} {
+	level_{level}, path_{}, logger_{logger}, console_{console}, daily_{}, ofs_{}, repeat_timeout_{}, repeat_{}, suppressing_{}, database_{}, db_{}, queue_capacity_{}, overflow_{}, async_{}, index_interval_{}, idx_ofs_{}, offset_{}, indexed_{}, latest_{}, mutex_{}, file_mutex_{}, console_mutex_{}, repeat_mutex_{}, db_mutex_{}, async_mutex_{}, sink_mutex_{} {
 	set_path(path, daily);
 }
 
-void logger_t::log_(level_t level, std::optional<std::source_location> const& pos, std::string_view const message) {
-	using namespace std::string_literals;
+logger_t::~logger_t() {
+	ignore_exceptions([this]() { flush_repeat_(); });
+	exchange_sink_(async_, nullptr);	// Writes the queued records before the sinks are closed.
+	exchange_sink_(db_, nullptr);		// Inserts the queued records before the members are destroyed.
+}
+
+void logger_t::set_queue(std::size_t capacity, overflow_t overflow) {
+	flush_repeat_();
+
+	std::lock_guard l{async_mutex_};
+
+	// Writes the queued records before changing the queue.
+	exchange_sink_(async_, nullptr);
+	queue_capacity_ = capacity;
+	overflow_		= overflow;
+	if (0u < capacity) {
+		exchange_sink_(async_, std::make_shared<impl::async_sink_t>(capacity, overflow, [this](impl::record_t const& record) { write_(record); }, [this](std::size_t drops) { return make_dropped_(drops); }));
+	}
+}
+
+void logger_t::set_database(std::filesystem::path const& path, std::string_view const table, std::size_t capacity) {
+	std::lock_guard l{db_mutex_};
+
+	// Stores the rows to the current database before opening another.
+	exchange_sink_(db_, nullptr);
+	database_.clear();
+	if (! path.empty()) {
+		validate_argument(0u < capacity);
+		exchange_sink_(db_, std::make_shared<impl::db_sink_t>(path, table, capacity, [this](std::size_t drops) { return make_dropped_(drops); }));
+		database_ = path;
+	}
+}
 
+void logger_t::set_repeat_suppression(bool on, std::chrono::milliseconds timeout) {
+	flush_repeat_();
+
+	std::lock_guard lock{repeat_mutex_};
+	repeat_timeout_ = on ? std::optional{timeout} : std::nullopt;
+	suppressing_.store(on, std::memory_order_relaxed);
+}
+
+void logger_t::log_(level_t level, std::optional<std::source_location> const& pos, std::string_view const message) {
 	validate_argument(level != level_t::Silent && level != level_t::All);
 	if (pos) {
 		validate_argument(pos->file_name() != nullptr && pos->function_name() != nullptr);
 	}
 
 	if (static_cast<int>(level_) < static_cast<int>(level)) {
+		expire_repeat_();
+		return;
+	}
+	if (suppress_repeat_(level, pos, message)) {
 		return;
 	}
 
+	output_(level, pos, message);
+}
+
+bool logger_t::suppress_repeat_(level_t level, std::optional<std::source_location> const& pos, std::string_view const message) {
+	if (! suppressing_.load(std::memory_order_relaxed)) return false;
+
+	auto const same_position = [](std::optional<std::source_location> const& lhs, std::optional<std::source_location> const& rhs) {
+		if (! lhs || ! rhs) return ! lhs && ! rhs;
+		return lhs->line() == rhs->line() && std::string_view{lhs->file_name()} == rhs->file_name() && std::string_view{lhs->function_name()} == rhs->function_name();
+	};
+
+	auto const hash = std::hash<std::string_view>{}(message);
+	auto const now	= std::chrono::steady_clock::now();
+
+	std::optional<repeat_t> previous;
+	bool					suppressed{};
+	{
+		std::lock_guard lock{repeat_mutex_};
+		if (! repeat_timeout_) return false;
+
+		// The hashes are compared first, and the messages only if they are the same, to tell collisions apart.
+		if (repeat_ && repeat_->hash == hash && repeat_->level == level && same_position(repeat_->pos, pos) && repeat_->message == message) {
+			suppressed = true;
+			++repeat_->count;
+			if (now - repeat_->since < *repeat_timeout_) return suppressed;
+
+			// Dumps the count periodically even if the duplicates continue.
+			previous	   = repeat_;
+			repeat_->count = 0u;
+			repeat_->since = now;
+		} else {
+			previous = std::exchange(repeat_, repeat_t{hash, std::string{message}, level, pos, 0u, now});
+		}
+	}
+	dump_repeat_(previous);
+	return suppressed;
+}
+
+void logger_t::expire_repeat_() {
+	if (! suppressing_.load(std::memory_order_relaxed)) return;
+
+	auto const now = std::chrono::steady_clock::now();
+
+	std::optional<repeat_t> previous;
+	{
+		std::lock_guard lock{repeat_mutex_};
+		if (! repeat_timeout_ || ! repeat_ || repeat_->count == 0u || now - repeat_->since < *repeat_timeout_) return;
+
+		// Dumps the count of the run which has been suppressed for the timeout, even if no duplicate follows it.
+		previous	   = repeat_;
+		repeat_->count = 0u;
+		repeat_->since = now;
+	}
+	dump_repeat_(previous);
+}
+
+void logger_t::flush_repeat_() {
+	std::optional<repeat_t> previous;
+	{
+		std::lock_guard lock{repeat_mutex_};
+		previous = std::exchange(repeat_, std::nullopt);
+	}
+	dump_repeat_(previous);
+}
+
+void logger_t::dump_repeat_(std::optional<repeat_t> const& repeat) {
+	if (repeat && 0u < repeat->count) {
+		output_(repeat->level, repeat->pos, "last message repeated " + std::to_string(repeat->count) + " times");
+	}
+}
+
+void logger_t::output_(level_t level, std::optional<std::source_location> const& pos, std::string_view const message) {
+	auto record{make_record_(level, pos, message)};
+	if (auto const async = load_sink_(async_); async) {
+		async->push(std::move(record));
+	} else {
+		write_(record);
+	}
+}
+
+impl::record_t
+logger_t::make_dropped_(std::size_t drops) const {
+	return make_record_(level_t::Warn, std::nullopt, "dropped " + std::to_string(drops) + " records");
+}
+
+impl::record_t
+logger_t::make_record_(level_t level, std::optional<std::source_location> const& pos, std::string_view const message) const {
+	using namespace std::string_literals;
+
 	char const* Lv[]{"[S]", "[F]", "[E]", "[W]", "[N]", "[I]", "[D]", "[T]", "[V]", "[A]"};
 
-	auto const filename{pos ? std::filesystem::path{pos->file_name()}.filename().string() : ""s};
+	impl::record_t record{level, std::chrono::system_clock::now(), {}, {}, pos ? std::filesystem::path{pos->file_name()}.filename().string() : ""s, pos ? pos->line() : 0u, {}, std::string{message}, {}};
 
 	std::ostringstream oss;
-
-	std::tm lt{};
 	{
 		using namespace std::chrono_literals;
 
-		auto const now = std::chrono::system_clock::now();
-		get_local_now_(now, lt);
-		auto const ms = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()) % 1s;
+		get_local_now_(record.time, record.lt);
+		auto const ms = std::chrono::duration_cast<std::chrono::microseconds>(record.time.time_since_epoch()) % 1s;
 
-		oss << std::put_time(&lt, "%FT%T.")
+		oss << std::put_time(&record.lt, "%FT%T.")
 			<< std::setfill('0') << std::setw(6) << ms.count()
-			<< std::put_time(&lt, "%z")
+			<< std::put_time(&record.lt, "%z")
 			<< Lv[static_cast<int>(level)];
-		oss << std::setfill('_') << std::setw(5) << std::hex << std::uppercase << std::this_thread::get_id() << std::dec;
+		{
+			std::ostringstream id;
+			id << std::setfill('_') << std::setw(5) << std::hex << std::uppercase << std::this_thread::get_id();
+			record.tid = id.str();
+		}
+		oss << record.tid;
 		if (pos) {
 			std::cmatch result;
-			oss << "{" << filename << ':' << std::setw(5) << std::setfill('_') << pos->line() << "} ";
-			oss << (std::regex_match(pos->function_name(), result, function_name_re) ? result.str(1) : pos->function_name()) << " ";
+			record.function = std::regex_match(pos->function_name(), result, function_name_re) ? result.str(1) : pos->function_name();
+			oss << "{" << record.file << ':' << std::setw(5) << std::setfill('_') << pos->line() << "} ";
+			oss << record.function << " ";
 		}
 		oss << message;
 	}
-	auto const str{oss.str()};
+	record.text = oss.str();
+	return record;
+}
+
+void logger_t::write_(impl::record_t const& record) {
+	using namespace std::string_literals;
+
+	auto const& str{record.text};
+	auto const& lt{record.lt};
+	auto const	level{record.level};
 
 	if (console_) {
 		ignore_exceptions([this, &str, level]() {
@@ -121,27 +813,33 @@ void logger_t::log_(level_t level, std::optional<std::source_location> const& po
 		});
 	}
 	if (! path_.empty()) {
-		ignore_exceptions([&str, &lt, this]() {
+		ignore_exceptions([&str, &lt, &record, this]() {
 			std::lock_guard lock{file_mutex_};
 
 			if (needs_rotation(lt)) {
 				// Rotates previous log file if necessary.
 				// Closes current log file if exists.
-				if (ofs_.is_open()) {
-					ofs_.close();
-				}
-				ofs_.clear();
-
-				std::filesystem::rename(path_, get_previous_path_());
+				close_logfile_();
+				rotate_logfile_();
 				open_logfile_(path_, daily_);
 			}
 			daily_ = lt;
 
 			if (ofs_.is_open()) {
+				// Records are timestamped before this lock, so that they might be written out of order.
+				// The index has the latest timestamp so far instead of the record's, which never decreases.
+				latest_ = std::max(latest_, static_cast<std::int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(record.time.time_since_epoch()).count()));
+				if (idx_ofs_.is_open() && (! indexed_ || index_interval_ <= offset_ - *indexed_)) {
+					// Indexes this record; pairs of the timestamp in microseconds and the offset.
+					index_entry_t const entry{latest_, static_cast<std::int64_t>(offset_)};
+					idx_ofs_.write(reinterpret_cast<char const*>(entry.data()), sizeof(entry));
+					indexed_ = offset_;
+				}
 				ofs_ << str << '\n';
 				// It does not use std::endl() for performance
 				// because the std::endl flushes stream, too.
 				// But as the result, all the logs would Not be stored at this program crushed.
+				offset_ += str.size() + 1u;
 			}
 		});
 	}
@@ -176,6 +874,9 @@ void logger_t::log_(level_t level, std::optional<std::source_location> const& po
 #endif
 		});
 	}
+	if (auto const db = load_sink_(db_); db) {
+		ignore_exceptions([&record, &db]() { db->insert(record); });
+	}
 }
 
 void logger_t::get_local_now_(std::chrono::system_clock::time_point const& now, std::tm& tm) const {
@@ -236,16 +937,66 @@ void logger_t::open_logfile_(std::filesystem::path const& path, std::optional<st
 		daily_ = std::nullopt;
 		throw;	  // Don't take care of file stream here.
 	}
+	offset_ = std::filesystem::file_size(path);
+	if (0u < index_interval_) {
+		open_index_();
+	}
 }
 
-void logger_t::set_path(std::filesystem::path const& path, bool daily) {
-	std::lock_guard l{file_mutex_};
-
-	// Closes current log file once if exists.
+void logger_t::close_logfile_() {
 	if (ofs_.is_open()) {
 		ofs_.close();
 	}
 	ofs_.clear();
+	if (idx_ofs_.is_open()) {
+		idx_ofs_.close();
+	}
+	idx_ofs_.clear();
+}
+
+void logger_t::rotate_logfile_() {
+	auto const previous = get_previous_path_();
+	std::filesystem::rename(path_, previous);
+
+	// Moves the time index along with the log file.
+	if (auto const index = get_index_path_(path_); std::filesystem::exists(index)) {
+		std::filesystem::rename(index, get_index_path_(previous));
+	}
+}
+
+void logger_t::open_index_() {
+	if (idx_ofs_.is_open() || ! ofs_.is_open()) return;
+
+	// Keeps the timestamps of the entries never decreasing over the runs.
+	if (auto const last = validate_index_(path_, offset_); last) latest_ = std::max(latest_, (*last)[0]);
+
+	idx_ofs_.exceptions(std::ios::badbit | std::ios::failbit);
+	idx_ofs_.open(get_index_path_(path_), std::ios::app | std::ios::binary);
+	idx_ofs_.exceptions(std::ios::badbit);
+
+	indexed_ = std::nullopt;	// Indexes the next record anyway.
+}
+
+void logger_t::set_index_interval(std::size_t interval) {
+	std::lock_guard l{file_mutex_};
+
+	index_interval_ = interval;
+	if (0u < index_interval_) {
+		open_index_();
+	} else if (idx_ofs_.is_open()) {
+		idx_ofs_.close();
+		idx_ofs_.clear();
+	}
+}
+
+void logger_t::set_path(std::filesystem::path const& path, bool daily) {
+	// Dumps the count of suppressed duplicates to the current log file.
+	flush_repeat_();
+
+	std::lock_guard l{file_mutex_};
+
+	// Closes current log file once if exists.
+	close_logfile_();
 
 	// Gets current time.
 	auto const now = std::chrono::system_clock::now();
@@ -254,7 +1005,7 @@ void logger_t::set_path(std::filesystem::path const& path, bool daily) {
 
 	// rotates previous log file if necessary.
 	if (needs_rotation(lt)) {
-		std::filesystem::rename(path_, get_previous_path_());
+		rotate_logfile_();
 	}
 	// Opens a new log file if the path is not empty.
 	if (daily) {
@@ -272,14 +1023,14 @@ std::unique_ptr<std::unordered_map<std::string, std::unique_ptr<logger_t>>> logg
 void add_logger(std::string const& tag, level_t level, std::filesystem::path const& path, std::string_view const logger, bool console) {
 	validate_argument(! tag.empty());
 
-	std::lock_guard lock{loggers_mutex_s};
-
 	std::call_once(logger_once_s, []() {
 		std::lock_guard lock{loggers_mutex_s};
 		if (! loggers_s) loggers_s = std::make_unique<std::unordered_map<std::string, std::unique_ptr<logger_t>>>();
 		if (! loggers_s->contains("")) { loggers_s->insert(std::make_pair("", std::make_unique<logger_t>())); }
 	});
 
+	std::lock_guard lock{loggers_mutex_s};
+
 	auto itr{loggers_s->find(tag)};
 	validate_argument(itr == std::end(*loggers_s));
 
@@ -316,6 +1067,127 @@ logger_t& logger(std::string const& tag) {
 	return *itr->second;
 }
 
+std::optional<std::chrono::system_clock::time_point> parse_timestamp(std::string_view const text) {
+	std::size_t pos{};
+	auto const	number = [&text, &pos](std::size_t digits) -> std::optional<int> {
+		if (text.size() < pos + digits) return std::nullopt;
+		int n{};
+		for (auto const ch: text.substr(pos, digits)) {
+			if (ch < '0' || '9' < ch) return std::nullopt;
+			n = n * 10 + (ch - '0');
+		}
+		pos += digits;
+		return n;
+	};
+	auto const separator = [&text, &pos](char ch) {
+		if (text.size() <= pos || text[pos] != ch) return false;
+		++pos;
+		return true;
+	};
+
+	// e.g. 2018-01-23T01:23:45.678901+0900
+	auto const year = number(4);
+	if (! year || ! separator('-')) return std::nullopt;
+	auto const month = number(2);
+	if (! month || ! separator('-')) return std::nullopt;
+	auto const day = number(2);
+	if (! day || ! separator('T')) return std::nullopt;
+	auto const hour = number(2);
+	if (! hour || ! separator(':')) return std::nullopt;
+	auto const minute = number(2);
+	if (! minute || ! separator(':')) return std::nullopt;
+	auto const second = number(2);
+	if (! second) return std::nullopt;
+
+	std::chrono::microseconds fraction{};
+	if (separator('.')) {
+		auto scale = 100000;
+		for (; pos < text.size() && '0' <= text[pos] && text[pos] <= '9'; ++pos, scale /= 10) {
+			fraction += std::chrono::microseconds{(text[pos] - '0') * scale};
+		}
+	}
+
+	std::optional<std::chrono::minutes> zone;
+	if (pos < text.size() && (text[pos] == '+' || text[pos] == '-')) {
+		auto const sign = text[pos++] == '-' ? -1 : 1;
+		auto const hh	= number(2);
+		auto const mm	= number(2);
+		if (! hh || ! mm) return std::nullopt;
+		zone = std::chrono::minutes{sign * (*hh * 60 + *mm)};
+	}
+
+	std::chrono::system_clock::time_point time;
+	if (zone) {
+		std::chrono::year_month_day const ymd{std::chrono::year{*year}, std::chrono::month{static_cast<unsigned>(*month)}, std::chrono::day{static_cast<unsigned>(*day)}};
+		if (! ymd.ok()) return std::nullopt;
+		time = std::chrono::sys_days{ymd} + std::chrono::hours{*hour} + std::chrono::minutes{*minute} + std::chrono::seconds{*second} - *zone;
+	} else {
+		// Local time.
+		std::tm lt{};
+		lt.tm_year	= *year - 1900;
+		lt.tm_mon	= *month - 1;
+		lt.tm_mday	= *day;
+		lt.tm_hour	= *hour;
+		lt.tm_min	= *minute;
+		lt.tm_sec	= *second;
+		lt.tm_isdst = -1;
+		auto const tt{std::mktime(&lt)};
+		if (tt == static_cast<std::time_t>(-1)) return std::nullopt;
+		time = std::chrono::system_clock::from_time_t(tt);
+	}
+	return time + fraction;
+}
+
+std::uint64_t find_log_offset(std::filesystem::path const& path, std::chrono::system_clock::time_point const& from) {
+	auto const index = get_index_path_(path);
+	if (! std::filesystem::exists(index)) return 0u;
+
+	std::ifstream ifs;
+	ifs.exceptions(std::ios::badbit | std::ios::failbit);
+	ifs.open(index, std::ios::binary);
+
+	// Starts at the last entry before the time.
+	// An incomplete entry at the tail, if any, is ignored.
+	auto const n = search_index_(ifs, std::filesystem::file_size(index) / sizeof(index_entry_t), from);
+	return n == 0u ? 0u : static_cast<std::uint64_t>(read_index_entry_(ifs, n - 1u)[1]);
+}
+
+void read_logs(std::filesystem::path const& path, std::chrono::system_clock::time_point const& from, std::chrono::system_clock::time_point const& to, std::function<void(std::string_view const)> const& reader) {
+	validate_argument(static_cast<bool>(reader));
+	if (to <= from) return;
+
+	std::ifstream ifs;
+	ifs.exceptions(std::ios::badbit);
+	ifs.open(path, std::ios::binary);
+	if (! ifs) throw std::runtime_error(__func__);
+
+	auto offset = find_log_offset(path, from);
+	ifs.seekg(static_cast<std::streamoff>(offset));
+
+	// Records might be written out of order, so that it reads past the first record at the end of the range,
+	// up to the entry following the first one whose latest timestamp reaches the end; or to the end of the file without the index.
+	auto end = std::numeric_limits<std::uint64_t>::max();
+	if (auto const index = get_index_path_(path); std::filesystem::exists(index)) {
+		std::ifstream idx;
+		idx.exceptions(std::ios::badbit | std::ios::failbit);
+		idx.open(index, std::ios::binary);
+		auto const entries = std::filesystem::file_size(index) / sizeof(index_entry_t);
+		if (auto const n = search_index_(idx, entries, to); n + 1u < entries) end = static_cast<std::uint64_t>(read_index_entry_(idx, n + 1u)[1]);
+	}
+
+	// Lines without timestamp belong to the previous log.
+	auto in_range{false};
+	for (std::string line; std::getline(ifs, line); offset += line.size() + 1u) {
+		if (auto const time = parse_timestamp(line); time) {
+			if (end <= offset) break;
+			in_range = from <= *time && *time < to;
+		}
+		if (in_range) {
+			reader(line);
+		}
+	}
+}
+
 #endif	  // xxx_no_logging
 
 }
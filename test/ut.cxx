@@ -6,11 +6,25 @@
 
 #include <xxx/config.hxx>
 #include <xxx/exceptions.hxx>
+#include <xxx/executor.hxx>
+#include <xxx/keyed_executor.hxx>
 #include <xxx/files.hxx>
 #include <xxx/finally.hxx>
 #include <xxx/logger.hxx>
 #include <xxx/queue.hxx>
+#include <xxx/co_queue.hxx>
+#include <xxx/delay_queue.hxx>
+#include <xxx/durable_queue.hxx>
+#include <xxx/pipeline.hxx>
+#include <xxx/broadcast_ring.hxx>
+#include <xxx/pollable_queue.hxx>
+#include <xxx/queue_selector.hxx>
+#include <xxx/mpsc_mailbox.hxx>
+#include <xxx/mpmc_queue.hxx>
+#include <xxx/priority_queue.hxx>
+#include <xxx/spsc_queue.hxx>
 #include <xxx/redux.hxx>
+#include <xxx/sharded_queue.hxx>
 #include <xxx/sig.hxx>
 #include <xxx/db.hxx>
 #include <xxx/xxx.hxx>
@@ -18,12 +32,20 @@
 #include <gtest/gtest.h>
 
 #include <tuple>
+#include <atomic>
 #include <fstream>
+#include <future>
 #include <iomanip>
 #include <iostream>
 #include <regex>
 #include <sstream>
 #include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if defined(xxx_posix)
+#include <poll.h>
+#endif
 
 TEST(test_cpp, Initialize)
 {
@@ -885,6 +907,19 @@ TEST(test_logger, Enclose)
 	using namespace std::string_literals;
 	EXPECT_EQ("(arg,2)"s, xxx::log::enclose("arg", 2));
 }
+TEST(test_logger, Escape)
+{
+	using namespace std::string_literals;
+	EXPECT_EQ("abc"s, xxx::log::cat(std::u8string_view{u8"abc"}));
+	EXPECT_EQ("a\\\"b\\\\c\\n\\x01\\xC3\\xA9"s, xxx::log::cat(std::u8string{u8"a\"b\\c\n\x01\u00e9"}));
+	EXPECT_EQ("a\\\"b\\t\\u0001\u00e9"s, xxx::log::escape("a\"b\t\x01\u00e9", xxx::log::escape_t::Json));
+
+	// Long enough for the vectorized kernel.
+	auto const clean{std::string(100, 'x')};
+	EXPECT_EQ(clean, xxx::log::escape(clean));
+	EXPECT_EQ(clean + "\\x7F" + clean, xxx::log::escape(clean + "\x7F" + clean));
+	EXPECT_EQ(clean + "\\\"" + clean + "\\u001F", xxx::log::escape(clean + "\"" + clean + "\x1F", xxx::log::escape_t::Json));
+}
 
 TEST(test_logger, Trace)
 {
@@ -952,6 +987,289 @@ TEST(test_logger, Trace)
 	}
 }
 
+namespace
+{
+	// String literal as a template argument.
+	template <std::size_t N>
+	struct literal_t
+	{
+		char data[N];
+		consteval literal_t(char const (&s)[N])
+		{
+			std::copy_n(s, N, data);
+		}
+	};
+
+	// Whether the format string is accepted with the arguments, which is evaluated at compile time.
+	template <literal_t Format, typename... Args>
+	concept valid_format = requires { typename std::bool_constant<(xxx::log::format_t<Args...>{Format.data}, true)>; };
+} // namespace
+
+TEST(test_logger, Format)
+{
+	using namespace std::string_literals;
+	std::filesystem::path const path{"test.log"};
+	auto &logger = xxx::log::logger("");
+	logger.set_level(xxx::log::level_t::Info);
+	logger.set_console(false);
+	logger.set_path("");
+	if (std::filesystem::exists(path))
+	{
+		std::filesystem::remove(path);
+	}
+
+	logger.set_path(path);
+	logger.infof("a{}b{}c{{{}}}", 1, "2"s, std::vector<int>{3, 4});
+	logger.debugf("filtered {}", 5);
+	logger.logf(xxx::log::level_t::Info, "info");
+	logger.set_path("");
+
+	std::istringstream iss{read_and_clear_log(path)};
+	std::vector<std::string> lines;
+	for (std::string line; std::getline(iss, line);)
+	{
+		lines.push_back(line);
+	}
+	ASSERT_EQ(2u, lines.size());
+	EXPECT_TRUE(lines.at(0).ends_with(" a1b2c{[3,4]}"));
+	EXPECT_TRUE(lines.at(1).ends_with(" info"));
+
+	// Bad format strings are rejected at compile time.
+	static_assert(valid_format<"a{}b{}c{{{}}}", int, std::string, std::vector<int>>);
+	static_assert(! valid_format<"{}">);
+	static_assert(! valid_format<"{}", int, int>);
+	static_assert(! valid_format<"{", int>);
+	static_assert(! valid_format<"}", int>);
+}
+
+TEST(test_logger, Repeat_suppression)
+{
+	std::filesystem::path const path{"test.log"};
+	auto &logger = xxx::log::logger("");
+	logger.set_level(xxx::log::level_t::All);
+	logger.set_console(false);
+	logger.set_path("");
+	if (std::filesystem::exists(path))
+	{
+		std::filesystem::remove(path);
+	}
+
+	logger.set_repeat_suppression(true);
+	EXPECT_TRUE(logger.repeat_suppression());
+	logger.set_path(path);
+	for (int i = 0; i < 3; ++i)
+	{
+		logger.info("same");
+	}
+	logger.info("other");
+	logger.info("same");
+	logger.set_repeat_suppression(false);
+	EXPECT_FALSE(logger.repeat_suppression());
+	logger.set_path("");
+
+	std::istringstream iss{read_and_clear_log(path)};
+	std::vector<std::string> lines;
+	for (std::string line; std::getline(iss, line);)
+	{
+		lines.push_back(line);
+	}
+	ASSERT_EQ(4u, lines.size());
+	EXPECT_TRUE(lines.at(0).ends_with(" same"));
+	EXPECT_TRUE(lines.at(1).ends_with(" last message repeated 2 times"));
+	EXPECT_TRUE(lines.at(2).ends_with(" other"));
+	EXPECT_TRUE(lines.at(3).ends_with(" same"));
+
+	// The count is dumped by any log after the timeout, even if it is filtered.
+	logger.set_repeat_suppression(true, std::chrono::milliseconds{50});
+	logger.set_path(path);
+	for (int i = 0; i < 3; ++i)
+	{
+		logger.info("same");
+		if (i == 1)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds{60});
+			logger.set_level(xxx::log::level_t::Info);
+			logger.debug("filtered");
+			logger.set_level(xxx::log::level_t::All);
+		}
+	}
+	logger.set_repeat_suppression(false);
+	logger.set_path("");
+
+	iss.str(read_and_clear_log(path));
+	iss.clear();
+	lines.clear();
+	for (std::string line; std::getline(iss, line);)
+	{
+		lines.push_back(line);
+	}
+	ASSERT_EQ(3u, lines.size());
+	EXPECT_TRUE(lines.at(0).ends_with(" same"));
+	EXPECT_TRUE(lines.at(1).ends_with(" last message repeated 1 times"));
+	EXPECT_TRUE(lines.at(2).ends_with(" last message repeated 1 times"));
+}
+
+TEST(test_logger, Queue)
+{
+	std::filesystem::path const path{"test.log"};
+	auto &logger = xxx::log::logger("");
+	logger.set_level(xxx::log::level_t::All);
+	logger.set_console(false);
+	logger.set_path("");
+	if (std::filesystem::exists(path))
+	{
+		std::filesystem::remove(path);
+	}
+	auto const read_lines = [&path]()
+	{
+		std::istringstream iss{read_and_clear_log(path)};
+		std::vector<std::string> lines;
+		for (std::string line; std::getline(iss, line);)
+		{
+			lines.push_back(line);
+		}
+		return lines;
+	};
+
+	for (auto const overflow : {xxx::log::overflow_t::Block, xxx::log::overflow_t::Spill})
+	{
+		logger.set_path(path);
+		logger.set_queue(1u, overflow);
+		EXPECT_EQ(1u, logger.queue_capacity());
+		EXPECT_EQ(overflow, logger.overflow());
+		for (int i = 0; i < 1000; ++i)
+		{
+			logger.info("line " + std::to_string(i));
+		}
+		logger.set_queue(0u);
+		logger.set_path("");
+
+		auto const lines = read_lines();
+		ASSERT_EQ(1000u, lines.size());
+		for (int i = 0; i < 1000; ++i)
+		{
+			EXPECT_TRUE(lines.at(i).ends_with(" line " + std::to_string(i)));
+		}
+	}
+	for (auto const overflow : {xxx::log::overflow_t::DropOldest, xxx::log::overflow_t::DropNewest})
+	{
+		logger.set_path(path);
+		logger.set_queue(1u, overflow);
+		for (int i = 0; i < 1000; ++i)
+		{
+			logger.debug("debug");
+			logger.err("err");
+		}
+		logger.set_queue(0u);
+		logger.set_path("");
+
+		// Errors are never dropped, and dropped debug logs are reported.
+		std::size_t errors{}, debugs{}, drops{};
+		std::regex const dropped_re{R"(.*\[W\].*dropped ([0-9]+) records$)"};
+		for (auto const &line : read_lines())
+		{
+			std::smatch m;
+			if (line.ends_with(" err"))
+				++errors;
+			else if (line.ends_with(" debug"))
+				++debugs;
+			else if (std::regex_match(line, m, dropped_re))
+				drops += std::stoul(m.str(1));
+		}
+		EXPECT_EQ(1000u, errors);
+		EXPECT_EQ(1000u, debugs + drops);
+	}
+}
+
+TEST(test_logger, Time_index)
+{
+	std::filesystem::path const path{"test.log"};
+	std::filesystem::path const index{"test.log.idx"};
+	auto &logger = xxx::log::logger("");
+	logger.set_level(xxx::log::level_t::All);
+	logger.set_console(false);
+	logger.set_path("");
+	for (auto const &p : {path, index})
+	{
+		if (std::filesystem::exists(p))
+			std::filesystem::remove(p);
+	}
+
+	EXPECT_FALSE(xxx::log::parse_timestamp("oops"));
+	EXPECT_FALSE(xxx::log::parse_timestamp("2018-13-23T01:23:45+0900"));
+	EXPECT_EQ(std::chrono::system_clock::time_point{std::chrono::sys_days{std::chrono::year{2018} / 1 / 22} + std::chrono::hours{16} + std::chrono::minutes{23} + std::chrono::microseconds{45678901}},
+			  xxx::log::parse_timestamp("2018-01-23T01:23:45.678901+0900[I]"));
+
+	logger.set_index_interval(1u);
+	EXPECT_EQ(1u, logger.index_interval());
+	logger.set_path(path);
+	for (auto i = 0; i < 5; ++i)
+		logger.info("a");
+	std::this_thread::sleep_for(std::chrono::milliseconds{10});
+	auto const from = std::chrono::floor<std::chrono::microseconds>(std::chrono::system_clock::now());	 // as precise as timestamps of logs
+	for (auto i = 0; i < 5; ++i)
+		logger.info("b");
+	auto const to = std::chrono::system_clock::now();
+	std::this_thread::sleep_for(std::chrono::milliseconds{10});
+	logger.info("c");
+	logger.set_path("");
+	logger.set_index_interval(0u);
+
+	ASSERT_TRUE(std::filesystem::exists(index));
+	EXPECT_EQ(11u * 16u, std::filesystem::file_size(index));
+	EXPECT_LT(0u, xxx::log::find_log_offset(path, from));
+
+	std::vector<std::string> lines;
+	xxx::log::read_logs(path, from, to, [&lines](std::string_view const line) { lines.emplace_back(line); });
+	ASSERT_EQ(5u, lines.size());
+	for (auto const &line : lines)
+		EXPECT_TRUE(line.ends_with(" b"));
+
+	// A record written out of order after the end of the range is read, too.
+	{
+		std::ofstream ofs{path, std::ios::app | std::ios::binary};
+		ofs << lines.front().substr(0u, lines.front().size() - 1u) << "late\n";
+	}
+	lines.clear();
+	xxx::log::read_logs(path, from, to, [&lines](std::string_view const line) { lines.emplace_back(line); });
+	ASSERT_EQ(6u, lines.size());
+	EXPECT_TRUE(lines.back().ends_with(" late"));
+
+	// The index left for a log recreated by others is rebuilt.
+	std::filesystem::remove(path);
+	logger.set_index_interval(1u);
+	logger.set_path(path);
+	logger.info("d");
+	logger.set_path("");
+	logger.set_index_interval(0u);
+	EXPECT_EQ(16u, std::filesystem::file_size(index));
+	EXPECT_EQ(0u, xxx::log::find_log_offset(path, to));
+	lines.clear();
+	xxx::log::read_logs(path, from, std::chrono::system_clock::now(), [&lines](std::string_view const line) { lines.emplace_back(line); });
+	ASSERT_EQ(1u, lines.size());
+	EXPECT_TRUE(lines.front().ends_with(" d"));
+
+	std::filesystem::remove(index);
+	read_and_clear_log(path);
+}
+
+TEST(test_logger, Add_logger_first)
+{
+	// The registry is initialized by add_logger() in a new process, and a deadlock times out.
+	GTEST_FLAG_SET(death_test_style, "threadsafe");
+	EXPECT_EXIT(
+		{
+			std::thread{[]()
+						{
+				std::this_thread::sleep_for(std::chrono::seconds{5});
+				std::_Exit(1); }}
+				.detach();
+			xxx::log::add_logger("first", xxx::log::level_t::All, "", "", false);
+			std::_Exit(0);
+		},
+		::testing::ExitedWithCode(0), "");
+}
+
 TEST(test_logger, Another_logger)
 {
 	std::filesystem::path const path{"test2.log"};
@@ -1119,6 +1437,1093 @@ TEST(test_queue, Queue)
 	EXPECT_TRUE(que.terminated());
 }
 
+TEST(test_queue, Bulk)
+{
+	static_assert(std::is_nothrow_default_constructible_v<xxx::queue<std::string>>);
+	xxx::queue<std::string> que;
+	std::vector<std::string> const v{"1", "2", "3", "4", "5"};
+	EXPECT_TRUE(que.enqueue_bulk(v));
+	EXPECT_EQ(5u, v.size());
+	EXPECT_TRUE(que.enqueue_bulk(std::vector<std::string>{"6", "7"}));
+
+	std::vector<std::string> out;
+	EXPECT_EQ(3u, que.dequeue_bulk(std::back_inserter(out), 3u));
+	EXPECT_EQ((std::vector<std::string>{"1", "2", "3"}), out);
+
+	std::vector<std::string> all{"0"};
+	EXPECT_TRUE(que.drain(all));
+	EXPECT_EQ((std::vector<std::string>{"0", "4", "5", "6", "7"}), all);
+	EXPECT_TRUE(que.empty());
+
+	que.enqueue_bulk(v);
+	xxx::queue<std::string>::container_type swapped;
+	EXPECT_TRUE(que.drain(swapped));
+	EXPECT_EQ(5u, swapped.size());
+	EXPECT_TRUE(que.empty());
+
+	// Views are copied from even if they are rvalues, and the sentinel might differ from the iterator.
+	std::vector<std::string> source{"a", "b", "c"};
+	EXPECT_TRUE(que.enqueue_bulk(source | std::views::take(2)));
+	EXPECT_TRUE(que.enqueue_bulk(std::views::take_while(source, [](auto const &s)
+														{ return s != "c"; })));
+	EXPECT_EQ((std::vector<std::string>{"a", "b", "c"}), source);
+	std::vector<std::string> taken;
+	EXPECT_TRUE(que.drain(taken));
+	EXPECT_EQ((std::vector<std::string>{"a", "b", "a", "b"}), taken);
+
+	que.terminate();
+	EXPECT_FALSE(que.enqueue_bulk(v));
+	EXPECT_EQ(0u, que.dequeue_bulk(std::back_inserter(out), 3u));
+	EXPECT_FALSE(que.drain(all));
+}
+
+TEST(test_queue, Move_only)
+{
+	xxx::queue<std::unique_ptr<int>> que;
+	EXPECT_FALSE(que.try_dequeue());
+	EXPECT_TRUE(que.enqueue(std::make_unique<int>(1)));
+	EXPECT_TRUE(que.emplace(new int{2}));
+	std::unique_ptr<int> e;
+	EXPECT_TRUE(que.dequeue(e));
+	EXPECT_EQ(1, *e);
+	auto const t = que.try_dequeue();
+	ASSERT_TRUE(t);
+	EXPECT_EQ(2, **t);
+	EXPECT_FALSE(que.try_dequeue());
+
+	// Blocks are reused.
+	for (auto i = 0; i < 10000; ++i)
+		que.emplace(std::make_unique<int>(i));
+	for (auto i = 0; i < 10000; ++i)
+		EXPECT_EQ(i, **que.try_dequeue());
+	xxx::queue<std::unique_ptr<int>>::container_type drained;
+	for (auto i = 0; i < 10000; ++i)
+		que.emplace(std::make_unique<int>(i));
+	EXPECT_TRUE(que.drain(drained));
+	EXPECT_EQ(10000u, drained.size());
+	EXPECT_TRUE(que.empty());
+
+	que.terminate();
+	EXPECT_FALSE(que.emplace(std::make_unique<int>(3)));
+	EXPECT_FALSE(que.try_dequeue());
+}
+
+TEST(test_queue, Timed)
+{
+	using namespace std::chrono_literals;
+
+	xxx::queue<int> que;
+	int e{};
+	EXPECT_FALSE(que.try_dequeue(e));
+	auto const begin = std::chrono::steady_clock::now();
+	EXPECT_FALSE(que.dequeue_for(e, 20ms));
+	EXPECT_LE(20ms, std::chrono::steady_clock::now() - begin);
+	EXPECT_FALSE(que.dequeue_until(e, std::chrono::system_clock::now() - 1s));
+
+	que.enqueue(1);
+	EXPECT_TRUE(que.try_dequeue(e));
+	EXPECT_EQ(1, e);
+	que.enqueue(2);
+	EXPECT_TRUE(que.dequeue_for(e, 1s));
+	EXPECT_EQ(2, e);
+
+	// Consumers spinning, parking and waiting with a timeout.
+	que.set_spin(1000u, 10u);
+	{
+		std::atomic<int> sum{};
+		std::vector<std::jthread> threads;
+		threads.emplace_back([&que, &sum]()
+							 { for (int n; que.dequeue(n);) sum += n; });
+		threads.emplace_back([&que, &sum]()
+							 { for (int n; que.dequeue_for(n, 1h);) sum += n; });
+		for (auto i = 1; i <= 1000; ++i)
+		{
+			que.enqueue(i);
+			if (i % 100 == 0)
+				std::this_thread::sleep_for(1ms);
+		}
+		while (sum < 1000 * 1001 / 2)
+			std::this_thread::yield();
+		que.terminate();
+	}
+	EXPECT_FALSE(que.dequeue_for(e, 1s));
+}
+
+TEST(test_queue, Statistics)
+{
+	using namespace std::chrono_literals;
+
+	xxx::queue<int, true> que;
+	que.enqueue(1);
+	que.enqueue_bulk(std::vector<int>{2, 3, 4});
+	std::this_thread::sleep_for(10ms);
+	int e{};
+	EXPECT_TRUE(que.dequeue(e));
+	std::vector<int> out;
+	EXPECT_EQ(2u, que.dequeue_bulk(std::back_inserter(out), 2u));
+
+	auto stats = que.statistics();
+	EXPECT_EQ(1u, stats.depth);
+	EXPECT_EQ(4u, stats.high_water);
+	EXPECT_EQ(4u, stats.enqueued);
+	EXPECT_EQ(3u, stats.dequeued);
+	EXPECT_LE(30ms, stats.latency);
+	EXPECT_LE(10ms, stats.max_latency);
+	EXPECT_EQ(0, stats.blocked.count());
+
+	// A consumer waits for an event.
+	EXPECT_TRUE(que.dequeue(e));
+	{
+		std::jthread consumer{[&que, &e]()
+							  { que.dequeue(e); }};
+		std::this_thread::sleep_for(50ms);
+		que.enqueue(5);
+	}
+	EXPECT_EQ(5, e);
+	stats = que.statistics();
+	EXPECT_EQ(0u, stats.depth);
+	EXPECT_EQ(5u, stats.dequeued);
+	EXPECT_LT(0, stats.blocked.count());
+
+	// Discarded events are not dequeued.
+	que.enqueue(6);
+	que.terminate();
+	stats = que.statistics();
+	EXPECT_EQ(6u, stats.enqueued);
+	EXPECT_EQ(5u, stats.dequeued);
+}
+
+TEST(test_queue, Priority_queue)
+{
+	using namespace std::chrono_literals;
+
+	EXPECT_THROW(xxx::priority_queue<int>{0u}, std::invalid_argument);
+	EXPECT_THROW(xxx::priority_queue<int>{65u}, std::invalid_argument);
+
+	xxx::priority_queue<std::string> que{3u, [](std::string const &s)
+										 { return s.starts_with("ctl") ? 0u : 2u; }};
+	EXPECT_EQ(3u, que.levels());
+	EXPECT_TRUE(que.empty());
+	EXPECT_TRUE(que.enqueue("bulk1"));
+	EXPECT_TRUE(que.enqueue("bulk2"));
+	EXPECT_TRUE(que.enqueue(1u, "mid"));
+	EXPECT_TRUE(que.enqueue("ctl"));
+	EXPECT_THROW(que.enqueue(3u, "out"), std::invalid_argument);
+	std::string e;
+	for (auto const *expected : {"ctl", "mid", "bulk1", "bulk2"})
+	{
+		EXPECT_TRUE(que.dequeue(e));
+		EXPECT_EQ(expected, e);
+	}
+	EXPECT_FALSE(que.try_dequeue(e));
+
+	// An aged event overtakes.
+	xxx::priority_queue<int> aged{2u, nullptr, 10ms};
+	aged.enqueue(1u, 1);
+	std::this_thread::sleep_for(20ms);
+	aged.enqueue(0u, 0);
+	int n;
+	EXPECT_TRUE(aged.dequeue(n));
+	EXPECT_EQ(1, n);
+	EXPECT_TRUE(aged.dequeue(n));
+	EXPECT_EQ(0, n);
+
+	// A waiting consumer.
+	{
+		std::jthread consumer{[&aged]()
+							  { int n; EXPECT_TRUE(aged.dequeue(n)); EXPECT_EQ(2, n); EXPECT_FALSE(aged.dequeue(n)); }};
+		std::this_thread::sleep_for(10ms);
+		aged.enqueue(1u, 2);
+		std::this_thread::sleep_for(10ms);
+		aged.terminate();
+	}
+	EXPECT_TRUE(aged.terminated());
+	EXPECT_FALSE(aged.enqueue(0u, 1));
+}
+
+TEST(test_queue, Sharded_queue)
+{
+	for (auto const sharding : {xxx::sharding_t::Affinity, xxx::sharding_t::RoundRobin})
+	{
+		xxx::sharded_queue<int> que{4u, sharding};
+		EXPECT_EQ(4u, que.lanes());
+		EXPECT_TRUE(que.empty());
+		EXPECT_TRUE(que.enqueue(1));
+		EXPECT_FALSE(que.empty());
+		int e{};
+		EXPECT_TRUE(que.try_dequeue(e));
+		EXPECT_EQ(1, e);
+		EXPECT_FALSE(que.try_dequeue(e));
+
+		std::atomic<long long> sum{};
+		{
+			std::vector<std::jthread> consumers;
+			for (auto c = 0; c < 4; ++c)
+			{
+				consumers.emplace_back([&que, &sum]()
+									   { for (int n; que.dequeue(n);) sum += n; });
+			}
+			{
+				std::vector<std::jthread> producers;
+				for (auto p = 0; p < 8; ++p)
+				{
+					producers.emplace_back([&que]()
+										   { for (auto i = 1; i <= 10000; ++i) EXPECT_TRUE(que.enqueue(i)); });
+				}
+			}
+			while (sum < 8 * 10000LL * 10001 / 2)
+				std::this_thread::yield();
+			que.terminate();
+		}
+		EXPECT_EQ(8 * 10000LL * 10001 / 2, sum);
+		EXPECT_TRUE(que.terminated());
+		EXPECT_FALSE(que.enqueue(1));
+		EXPECT_FALSE(que.dequeue(e));
+	}
+}
+
+TEST(test_queue, Mpmc_queue)
+{
+	xxx::mpmc_queue<std::string> que{3u};
+	EXPECT_EQ(4u, que.capacity());
+	EXPECT_TRUE(que.empty());
+	for (auto i = 0; i < 4; ++i)
+		EXPECT_TRUE(que.try_enqueue(std::to_string(i)));
+	EXPECT_FALSE(que.try_enqueue("full"));
+	EXPECT_EQ(4u, que.size());
+	std::string e;
+	EXPECT_TRUE(que.dequeue(e));
+	EXPECT_EQ("0", e);
+	EXPECT_TRUE(que.try_dequeue(e));
+	EXPECT_EQ("1", e);
+	EXPECT_EQ(2u, que.size());
+
+	// Producers and consumers.
+	xxx::mpmc_queue<int> mq{16u};
+	std::atomic<long long> sum{};
+	{
+		std::vector<std::jthread> threads;
+		for (auto c = 0; c < 4; ++c)
+		{
+			threads.emplace_back([&mq, &sum]()
+								 { for (int n; mq.dequeue(n) && n != 0;) sum += n; });
+		}
+		{
+			std::vector<std::jthread> producers;
+			for (auto p = 0; p < 4; ++p)
+			{
+				producers.emplace_back([&mq]()
+									   { for (auto i = 1; i <= 10000; ++i) EXPECT_TRUE(mq.enqueue(i)); });
+			}
+		}
+		for (auto c = 0; c < 4; ++c)
+			mq.enqueue(0);
+	}
+	mq.terminate();
+	EXPECT_EQ(4 * 10000LL * 10001 / 2, sum.load());
+	EXPECT_TRUE(mq.terminated());
+	EXPECT_FALSE(mq.enqueue(1));
+	int n;
+	EXPECT_FALSE(mq.dequeue(n));
+}
+
+TEST(test_queue, Spsc_queue)
+{
+	xxx::spsc_queue<std::unique_ptr<int>> que{3u};
+	EXPECT_EQ(4u, que.capacity());
+	EXPECT_TRUE(que.empty());
+	for (auto i = 0; i < 4; ++i)
+		EXPECT_TRUE(que.try_emplace(std::make_unique<int>(i)));
+	EXPECT_FALSE(que.try_enqueue(std::make_unique<int>(4)));
+	EXPECT_EQ(4u, que.size());
+	std::unique_ptr<int> e;
+	EXPECT_TRUE(que.try_dequeue(e));
+	EXPECT_EQ(0, *e);
+	EXPECT_EQ(3u, que.size());
+
+	// A producer and a consumer.
+	xxx::blocking_spsc_queue<int> bq{8u};
+	long long sum{};
+	{
+		std::jthread consumer{[&bq, &sum]()
+							  { for (int n; bq.dequeue(n) && n != 0;) sum += n; }};
+		for (auto i = 1; i <= 100000; ++i)
+			EXPECT_TRUE(bq.enqueue(i));
+		bq.enqueue(0);
+	}
+	EXPECT_EQ(100000LL * 100001 / 2, sum);
+	bq.terminate();
+	EXPECT_TRUE(bq.terminated());
+	EXPECT_FALSE(bq.enqueue(1));
+	int n;
+	EXPECT_FALSE(bq.dequeue(n));
+}
+
+TEST(test_executor, Executor)
+{
+	xxx::executor_t executor{4u, true};
+	EXPECT_EQ(4u, executor.size());
+
+	auto f1 = executor.submit([](int a, int b)
+							  { return a + b; },
+							  1, 2);
+	auto f2 = executor.submit([](std::unique_ptr<int> p)
+							  { return *p; },
+							  std::make_unique<int>(3));
+	auto f3 = executor.submit([]()
+							  { throw std::runtime_error("oops"); });
+	EXPECT_EQ(3, f1.get());
+	EXPECT_EQ(3, f2.get());
+	EXPECT_THROW(f3.get(), std::runtime_error);
+
+	std::vector<int> v(10000);
+	executor.parallel_for(0u, v.size(), [&v](std::size_t i)
+						  { v[i] = static_cast<int>(i); });
+	for (std::size_t i = 0; i < v.size(); ++i)
+		EXPECT_EQ(static_cast<int>(i), v[i]);
+	EXPECT_THROW(executor.parallel_for(0u, 100u, [](std::size_t i)
+									   { if (i == 50u) throw std::runtime_error("oops"); }),
+				 std::runtime_error);
+
+	// Nested parallel_for in tasks.
+	std::atomic<int> count{};
+	auto f4 = executor.submit([&executor, &count]()
+							  { executor.parallel_for(0u, 100u, [&executor, &count](std::size_t)
+													  { executor.parallel_for(0u, 10u, [&count](std::size_t)
+																			  { ++count; }); }); });
+	f4.get();
+	EXPECT_EQ(1000, count);
+
+	// Tasks posted are executed before terminated.
+	std::atomic<int> done{};
+	for (auto i = 0; i < 100; ++i)
+		EXPECT_TRUE(executor.post([&done]()
+								  { ++done; }));
+	executor.terminate();
+	EXPECT_EQ(100, done);
+	EXPECT_TRUE(executor.terminated());
+	EXPECT_FALSE(executor.post([]() {}));
+	auto f5 = executor.submit([]()
+							  { return 1; });
+	EXPECT_THROW(f5.get(), std::future_error);
+
+	// A task terminates the executor, and the destructor joins the workers.
+	{
+		xxx::executor_t inner{2u};
+		std::promise<void> terminated;
+		inner.post([&inner, &terminated]()
+				   {
+			inner.terminate();
+			terminated.set_value(); });
+		terminated.get_future().wait();
+		EXPECT_TRUE(inner.terminated());
+		EXPECT_FALSE(inner.post([]() {}));
+	}
+}
+
+TEST(test_executor, Keyed_executor)
+{
+	{
+		xxx::keyed_executor_t executor{4u, 8u};
+		EXPECT_EQ(4u, executor.size());
+
+		// Tasks of each key are executed one by one in order.
+		constexpr int keys = 16, count = 1000;
+		std::vector<std::vector<int>> sequences(keys);
+		std::vector<std::atomic<int>> running(keys);
+		std::atomic<bool> overlapped{false};
+		for (auto i = 0; i < count; ++i)
+		{
+			for (auto k = 0; k < keys; ++k)
+			{
+				EXPECT_TRUE(executor.post("account" + std::to_string(k), [&, i, k]()
+										  {
+					if (0 < running[k].fetch_add(1)) overlapped = true;
+					sequences[k].push_back(i);
+					running[k].fetch_sub(1); }));
+			}
+		}
+		executor.terminate();
+		EXPECT_FALSE(overlapped);
+		for (auto const &sequence : sequences)
+		{
+			ASSERT_EQ(static_cast<std::size_t>(count), sequence.size());
+			EXPECT_TRUE(std::ranges::is_sorted(sequence));
+		}
+		EXPECT_TRUE(executor.terminated());
+		EXPECT_FALSE(executor.post(0, []() {}));
+	}
+	{
+		// A busy key never stalls the other keys.
+		xxx::keyed_executor_t executor{2u, 1u};
+		std::promise<void> released;
+		auto const release = released.get_future().share();
+		std::atomic<int> done{0};
+		for (auto i = 0; i < 100; ++i)
+		{
+			executor.post(1, [release, &done]()
+						  {
+				release.wait();
+				++done; });
+		}
+		for (auto i = 0; i < 100; ++i)
+		{
+			executor.post(i + 2, [&done]()
+						  { ++done; });
+		}
+		executor.post(2, [&released]()
+					  { released.set_value(); });
+		executor.terminate();
+		EXPECT_EQ(200, done);
+	}
+	{
+		// A task terminates the executor while another key still has tasks, and concurrent calls join the workers once.
+		xxx::keyed_executor_t executor{2u};
+		std::atomic<int> done{0};
+		for (auto i = 0; i < 10; ++i)
+		{
+			executor.post(1, [&done]()
+						  { ++done; });
+		}
+		executor.post(0, [&executor]()
+					  { executor.terminate(); });
+		std::thread terminators[2];
+		for (auto &terminator : terminators)
+		{
+			terminator = std::thread{[&executor]()
+									 { executor.terminate(); }};
+		}
+		for (auto &terminator : terminators)
+			terminator.join();
+		EXPECT_EQ(10, done);
+		EXPECT_TRUE(executor.terminated());
+	}
+}
+
+namespace
+{
+	// Coroutine which starts eagerly and is never awaited.
+	struct detached_t
+	{
+		struct promise_type
+		{
+			detached_t get_return_object() noexcept { return {}; }
+			std::suspend_never initial_suspend() noexcept { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() noexcept {}
+			void unhandled_exception() noexcept { std::terminate(); }
+		};
+	};
+
+	detached_t consume(xxx::co_queue<int> &que, std::atomic<int> &sum, std::atomic<int> &count)
+	{
+		while (auto const n = co_await que.dequeue())
+		{
+			sum += *n;
+			++count;
+		}
+		--count;
+	}
+} // namespace
+
+TEST(test_queue, Co_queue)
+{
+	{
+		// Resumed on the producer's thread.
+		xxx::co_queue<int> que;
+		std::atomic<int> sum{}, count{};
+		que.enqueue(1);
+		consume(que, sum, count);
+		EXPECT_EQ(1, sum);
+		que.enqueue(2);
+		EXPECT_EQ(3, sum);
+		EXPECT_TRUE(que.empty());
+		que.terminate();
+		EXPECT_EQ(1, count);
+		EXPECT_FALSE(que.enqueue(3));
+	}
+	{
+		// Many consumers over a few threads.
+		xxx::executor_t executor{2u};
+		xxx::co_queue<int> que{[&executor](std::coroutine_handle<> h)
+							   { if (! executor.post([h]() { h.resume(); })) h.resume(); }};
+		std::atomic<int> sum{}, count{};
+		for (auto i = 0; i < 1000; ++i)
+			consume(que, sum, count);
+		for (auto i = 1; i <= 10000; ++i)
+			que.enqueue(i);
+		while (count < 10000)
+			std::this_thread::yield();
+		EXPECT_EQ(10000 * 10001 / 2, sum);
+		que.terminate();
+		executor.terminate();
+		EXPECT_EQ(10000 - 1000, count);
+	}
+	{
+		// Waiters left at destruction are handed to the scheduler, and resumed after it.
+		std::vector<std::coroutine_handle<>> handles;
+		std::atomic<int> sum{}, count{};
+		{
+			xxx::co_queue<int> que{[&handles](std::coroutine_handle<> h)
+								   { handles.push_back(h); }};
+			consume(que, sum, count);
+		}
+		ASSERT_EQ(1u, handles.size());
+		EXPECT_EQ(0, count);
+		handles.front().resume();
+		EXPECT_EQ(-1, count);
+	}
+}
+
+TEST(test_queue, Delay_queue)
+{
+	using namespace std::chrono_literals;
+
+	xxx::delay_queue<int> que{100us};
+	auto const begin = std::chrono::steady_clock::now();
+	EXPECT_TRUE(que.enqueue_after(30ms, 3));
+	EXPECT_TRUE(que.enqueue_after(10ms, 1));
+	auto const canceled = que.enqueue_after(20ms, 2);
+	EXPECT_TRUE(que.enqueue_at(begin + 500ms, 4));
+	EXPECT_EQ(4u, que.size());
+	int e{};
+	EXPECT_FALSE(que.try_dequeue(e));
+	EXPECT_TRUE(que.cancel(*canceled));
+	EXPECT_FALSE(que.cancel(*canceled));
+
+	EXPECT_TRUE(que.dequeue(e));
+	EXPECT_EQ(1, e);
+	EXPECT_LE(10ms, std::chrono::steady_clock::now() - begin);
+	EXPECT_TRUE(que.dequeue(e));
+	EXPECT_EQ(3, e);
+	EXPECT_LE(30ms, std::chrono::steady_clock::now() - begin);
+	EXPECT_TRUE(que.dequeue(e));
+	EXPECT_EQ(4, e);
+	EXPECT_LE(500ms, std::chrono::steady_clock::now() - begin);
+	EXPECT_TRUE(que.empty());
+
+	// Events cascading down the levels.
+	{
+		xxx::delay_queue<std::chrono::steady_clock::time_point> deadlines{100us};
+		std::vector<std::jthread> threads;
+		std::atomic<int> count{};
+		for (auto i = 0; i < 2; ++i)
+		{
+			threads.emplace_back([&deadlines, &count]()
+								 {
+				for (std::chrono::steady_clock::time_point deadline; deadlines.dequeue(deadline);) {
+					EXPECT_LE(deadline, std::chrono::steady_clock::now());
+					++count;
+				} });
+		}
+		for (auto i = 0; i < 1000; ++i)
+		{
+			auto const deadline = std::chrono::steady_clock::now() + (i * 97 % 1000) * 100us;
+			deadlines.enqueue_at(deadline, deadline);
+		}
+		while (count < 1000)
+			std::this_thread::yield();
+		deadlines.terminate();
+	}
+	// Consumers sleeping for a later deadline wake up for events ready and earlier deadlines.
+	{
+		xxx::delay_queue<std::chrono::steady_clock::time_point> deadlines{100us};
+		deadlines.enqueue_after(10s, std::chrono::steady_clock::now() + 10s);
+		std::vector<std::jthread> threads;
+		std::atomic<int> count{};
+		std::atomic<bool> late{};
+		for (auto i = 0; i < 4; ++i)
+		{
+			threads.emplace_back([&deadlines, &count, &late]()
+								 {
+				for (std::chrono::steady_clock::time_point deadline; deadlines.dequeue(deadline);) {
+					if (deadline + 1s < std::chrono::steady_clock::now()) late = true;
+					std::this_thread::sleep_for(1ms);
+					++count;
+				} });
+		}
+		std::this_thread::sleep_for(10ms);
+		for (auto i = 0; i < 100; ++i)
+		{
+			auto const deadline = std::chrono::steady_clock::now() + (i % 2) * 20ms;
+			deadlines.enqueue_at(deadline, deadline);
+		}
+		while (count < 100)
+			std::this_thread::yield();
+		EXPECT_FALSE(late);
+		EXPECT_EQ(1u, deadlines.size());
+		deadlines.terminate();
+	}
+	que.terminate();
+	EXPECT_FALSE(que.enqueue_after(1ms, 0));
+	EXPECT_FALSE(que.dequeue(e));
+}
+
+TEST(test_queue, Durable_queue)
+{
+	std::filesystem::path const directory{"test.queue"};
+	std::filesystem::remove_all(directory);
+
+	auto const count_segments = [&directory]()
+	{
+		return std::ranges::count_if(std::filesystem::directory_iterator{directory}, [](auto const &entry)
+									 { return entry.path().extension() == ".seg"; });
+	};
+	std::string e;
+	{
+		xxx::durable_queue_t que{directory, 256u, std::chrono::milliseconds{1}};
+		EXPECT_TRUE(que.empty());
+		EXPECT_THROW(que.enqueue(std::string(256u, 'x')), std::invalid_argument);
+		for (auto i = 0; i < 100; ++i)
+			EXPECT_TRUE(que.enqueue("event-" + std::to_string(i)));
+		que.enqueue("");
+		que.commit();
+		for (auto i = 0; i < 30; ++i)
+		{
+			EXPECT_TRUE(que.dequeue(e));
+			EXPECT_EQ("event-" + std::to_string(i), e);
+		}
+		EXPECT_EQ(71u, que.size());
+	}
+	{
+		// Reopens the log after a restart.
+		xxx::durable_queue_t que{directory, 256u, std::chrono::milliseconds{1}};
+		EXPECT_EQ(71u, que.size());
+		for (auto i = 30; i < 100; ++i)
+		{
+			EXPECT_TRUE(que.try_dequeue(e));
+			EXPECT_EQ("event-" + std::to_string(i), e);
+		}
+		EXPECT_TRUE(que.dequeue(e));
+		EXPECT_EQ("", e);
+		EXPECT_FALSE(que.try_dequeue(e));
+
+		// Segments are recycled.
+		std::atomic<int> sum{};
+		std::jthread consumer{[&que, &sum]()
+							  { for (std::string s; que.dequeue(s);) sum += std::stoi(s); }};
+		for (auto i = 1; i <= 1000; ++i)
+		{
+			que.enqueue(std::to_string(i));
+			if (i % 100 == 0)
+				que.commit();
+		}
+		while (sum < 1000 * 1001 / 2)
+			std::this_thread::yield();
+		que.commit();
+		que.terminate();
+		EXPECT_FALSE(que.enqueue("oops"));
+	}
+	EXPECT_GE(4, count_segments());
+	{
+		xxx::durable_queue_t que{directory, 256u};
+		EXPECT_TRUE(que.empty());
+		EXPECT_TRUE(que.enqueue("last"));
+	}
+	{
+		xxx::durable_queue_t que{directory, 256u};
+		EXPECT_TRUE(que.try_dequeue(e));
+		EXPECT_EQ("last", e);
+	}
+	{
+		// commit() stores the consumer offset even if nothing is enqueued,
+		// which the copy of the directory taken before the destructor sees.
+		std::filesystem::path const copy{directory.string() + "-copy"};
+		std::filesystem::remove_all(copy);
+		{
+			xxx::durable_queue_t que{directory, 256u, std::chrono::hours{1}};
+			EXPECT_TRUE(que.enqueue("first"));
+			EXPECT_TRUE(que.enqueue("second"));
+			que.commit();
+			EXPECT_TRUE(que.try_dequeue(e));
+			EXPECT_EQ("first", e);
+			que.commit();
+			std::filesystem::copy(directory, copy);
+		}
+		{
+			xxx::durable_queue_t que{copy, 256u};
+			EXPECT_TRUE(que.try_dequeue(e));
+			EXPECT_EQ("second", e);
+		}
+		std::filesystem::remove_all(copy);
+	}
+	std::filesystem::remove_all(directory);
+}
+
+TEST(test_queue, Pipeline)
+{
+	{
+		// Stages of unordered output followed by a stage of ordered output.
+		auto pipeline = xxx::pipeline<int>{16u}
+							.then([](int &&n)
+								  { return std::to_string(n); }, {.workers = 4u, .batch = 8u})
+							.then([](std::string &&s)
+								  {
+								if (s == "13") throw std::runtime_error(s);
+								return std::stoi(s) * 2; }, {.workers = 3u, .batch = 4u, .ordered = true});
+		std::jthread producer{[&pipeline]()
+							  {
+			for (auto i = 0; i < 1000; ++i) pipeline.enqueue(i);
+			pipeline.terminate(); }};
+		std::vector<int> outputs;
+		for (int n; pipeline.dequeue(n);)
+			outputs.push_back(n);
+		EXPECT_FALSE(pipeline.enqueue(0));
+		pipeline.wait();
+
+		ASSERT_EQ(999u, outputs.size());
+		EXPECT_TRUE(std::ranges::is_sorted(outputs));
+		EXPECT_EQ(24, outputs[12]);
+		EXPECT_EQ(28, outputs[13]);
+		auto const statistics = pipeline.statistics();
+		ASSERT_EQ(2u, statistics.size());
+		EXPECT_EQ(4u, statistics[0].workers);
+		EXPECT_EQ(1000u, statistics[0].processed);
+		EXPECT_EQ(0u, statistics[0].failed);
+		EXPECT_EQ(1000u, statistics[1].processed);
+		EXPECT_EQ(1u, statistics[1].failed);
+		EXPECT_EQ(0u, statistics[1].backlog);
+	}
+	{
+		// The last stage consumes items in order.
+		std::vector<int> consumed;
+		auto pipeline = xxx::pipeline<int>{}
+							.then([](int &&n)
+								  { return n + 1; }, {.workers = 2u})
+							.then([&consumed](int &&n)
+								  { consumed.push_back(n); }, {.workers = 2u, .batch = 16u, .ordered = true});
+		for (auto i = 0; i < 1000; ++i)
+			pipeline.enqueue(i);
+		pipeline.terminate();
+		pipeline.wait();
+		ASSERT_EQ(1000u, consumed.size());
+		EXPECT_EQ(1, consumed.front());
+		EXPECT_TRUE(std::ranges::is_sorted(consumed));
+	}
+	{
+		// Results waiting for a slow first item are bounded by the capacity.
+		std::atomic<int> started{};
+		std::atomic<bool> released{};
+		auto pipeline = xxx::pipeline<int>{4u}.then([&started, &released](int &&n)
+													{
+								++started;
+								while (n == 0 && ! released) std::this_thread::sleep_for(std::chrono::milliseconds{1});
+								return n; }, {.workers = 4u, .ordered = true});
+		std::jthread producer{[&pipeline]()
+							  {
+			for (auto i = 0; i < 100; ++i) pipeline.enqueue(i);
+			pipeline.terminate(); }};
+		std::this_thread::sleep_for(std::chrono::milliseconds{100});
+		EXPECT_GT(20, started.load());
+		released = true;
+		std::vector<int> outputs;
+		for (int n; pipeline.dequeue(n);)
+			outputs.push_back(n);
+		ASSERT_EQ(100u, outputs.size());
+		EXPECT_TRUE(std::ranges::is_sorted(outputs));
+	}
+	{
+		// The consumer ends the input while a producer waits for a room, and the end follows its items.
+		auto pipeline = xxx::pipeline<int>{2u}.then([](int &&n)
+													{ return n; });
+		std::size_t queued{};
+		std::jthread producer{[&pipeline, &queued]()
+							  {
+			for (auto i = 0; i < 100 && pipeline.enqueue(i); ++i) ++queued; }};
+		std::this_thread::sleep_for(std::chrono::milliseconds{10});
+		pipeline.terminate();
+		EXPECT_TRUE(pipeline.terminated());
+		std::vector<int> outputs;
+		for (int n; pipeline.dequeue(n);)
+			outputs.push_back(n);
+		producer.join();
+		EXPECT_EQ(queued, outputs.size());
+		EXPECT_TRUE(std::ranges::is_sorted(outputs));
+	}
+	{
+		// The items left are discarded.
+		auto pipeline = xxx::pipeline<int>{4u}.then([](int &&n)
+													{ return n; });
+		for (auto i = 0; i < 4; ++i)
+			pipeline.enqueue(i);
+	}
+}
+
+TEST(test_queue, Broadcast_ring)
+{
+	{
+		// Every consumer sees every event, and the journal precedes the handler.
+		xxx::broadcast_ring<std::uint64_t> ring{6u};
+		EXPECT_EQ(8u, ring.capacity());
+		auto &journal = ring.subscribe();
+		auto &replica = ring.subscribe();
+		auto &handler = ring.subscribe({&journal, &replica});
+		EXPECT_THROW(ring.subscribe({&journal, nullptr}), std::invalid_argument);
+		EXPECT_THROW(ring.publish_bulk(9u, [](std::uint64_t &, std::size_t) {}), std::invalid_argument);
+
+		constexpr std::uint64_t count = 10000u;
+		auto const run = [&ring](auto &consumer, auto &&f)
+		{
+			std::uint64_t expected = 0u;
+			bool ordered = true;
+			while (consumer.sequence() < count)
+			{
+				ring.consume(consumer, [&](std::uint64_t const &event)
+							 {
+					ordered = ordered && event == expected++;
+					f(event); });
+			}
+			return ordered;
+		};
+		bool preceded = true;
+		std::uint64_t sum = 0u;
+		auto journaled = std::async(std::launch::async, [&]()
+									{ return run(journal, [](std::uint64_t) {}); });
+		auto replicated = std::async(std::launch::async, [&]()
+									 { return run(replica, [](std::uint64_t) {}); });
+		auto handled = std::async(std::launch::async, [&]()
+								  { return run(handler, [&](std::uint64_t event)
+											   {
+				preceded = preceded && event < journal.sequence() && event < replica.sequence();
+				sum += event; }); });
+		for (std::uint64_t i = 0u; i < count;)
+		{
+			if (i % 3u == 0u)
+			{
+				EXPECT_TRUE(ring.publish(i++));
+			}
+			else
+			{
+				auto const n = std::min<std::uint64_t>(count - i, 5u);
+				EXPECT_TRUE(ring.publish_bulk(n, [i](std::uint64_t &slot, std::size_t k)
+											  { slot = i + k; }));
+				i += n;
+			}
+		}
+		EXPECT_TRUE(journaled.get());
+		EXPECT_TRUE(replicated.get());
+		EXPECT_TRUE(handled.get());
+		EXPECT_TRUE(preceded);
+		EXPECT_EQ(count * (count - 1u) / 2u, sum);
+		EXPECT_EQ(count, ring.cursor());
+		EXPECT_THROW(ring.subscribe(), std::logic_error);
+	}
+	{
+		// A failed event is skipped, and the terminated ring returns at once.
+		xxx::broadcast_ring<std::string> ring{4u};
+		auto &consumer = ring.subscribe();
+		EXPECT_EQ(0u, ring.try_consume(consumer, [](auto const &) {}));
+		for (auto const *s : {"a", "b", "c", "d"})
+			EXPECT_TRUE(ring.publish(std::string{s}));
+		std::string consumed;
+		EXPECT_THROW(ring.consume(consumer, [&consumed](std::string const &s)
+								  {
+			if (s == "b") throw std::runtime_error(s);
+			consumed += s; }),
+					 std::runtime_error);
+		EXPECT_EQ(2u, consumer.sequence());
+		EXPECT_EQ(2u, ring.try_consume(consumer, [&consumed](std::string const &s)
+									   { consumed += s; }));
+		EXPECT_EQ("acd", consumed);
+
+		auto waiting = std::async(std::launch::async, [&ring, &consumer]()
+								  { return ring.consume(consumer, [](auto const &) {}); });
+		std::this_thread::sleep_for(std::chrono::milliseconds{10});
+		ring.terminate();
+		EXPECT_EQ(0u, waiting.get());
+		EXPECT_FALSE(ring.publish("e"));
+	}
+}
+
+TEST(test_queue, Queue_selector)
+{
+	xxx::queue<int> low;
+	xxx::queue<std::string> high;
+	xxx::queue<int, true> other;
+	{
+		xxx::queue_selector_t selector;
+		EXPECT_EQ(0u, selector.add(low));
+		EXPECT_EQ(1u, selector.add(high, 1));
+		EXPECT_EQ(2u, selector.add(other));
+		EXPECT_EQ(3u, selector.size());
+		EXPECT_FALSE(selector.try_select());
+		EXPECT_FALSE(selector.select_for(std::chrono::milliseconds{10}));
+
+		// The queue with the higher priority is ready first, and the ones with the same priority are ready in turn.
+		low.enqueue(1);
+		low.enqueue(2);
+		other.enqueue(3);
+		high.enqueue("4");
+		EXPECT_EQ(1u, selector.select());
+		std::string s;
+		EXPECT_TRUE(high.try_dequeue(s));
+		EXPECT_EQ(2u, selector.select());
+		EXPECT_EQ(0u, selector.select());
+		EXPECT_EQ(2u, selector.select());
+		int n;
+		while (low.try_dequeue(n)) {}
+		EXPECT_TRUE(other.try_dequeue(n));
+		EXPECT_FALSE(selector.try_select());
+
+		// A consumer waits for producers of the queues.
+		std::jthread producer{[&low, &high]()
+							  {
+			for (auto i = 0; i < 1000; ++i) {
+				low.enqueue(i);
+				high.enqueue(std::to_string(i));
+			} }};
+		int sum = 0;
+		for (std::size_t count = 0u; count < 2000u;)
+		{
+			auto const i = selector.select();
+			ASSERT_TRUE(i);
+			if (*i == 0u && low.try_dequeue(n))
+			{
+				sum += n;
+				++count;
+			}
+			else if (*i == 1u && high.try_dequeue(s))
+			{
+				sum += std::stoi(s);
+				++count;
+			}
+		}
+		EXPECT_EQ(999 * 1000, sum);
+
+		// Terminated queues are never ready.
+		producer.join();
+		low.terminate();
+		high.terminate();
+		other.terminate();
+		EXPECT_FALSE(selector.select());
+	}
+	EXPECT_TRUE(low.terminated());
+	EXPECT_FALSE(low.enqueue(0));
+}
+
+TEST(test_queue, Mpsc_mailbox)
+{
+	struct message_t : xxx::mpsc_node_t
+	{
+		int producer;
+		int sequence;
+	};
+	{
+		xxx::mpsc_mailbox<message_t> mailbox;
+		message_t *m = nullptr;
+		EXPECT_TRUE(mailbox.empty());
+		EXPECT_FALSE(mailbox.try_dequeue(m));
+
+		// Messages are linked without any allocation.
+		std::vector<message_t> messages(3u);
+		for (auto &message : messages)
+			EXPECT_TRUE(mailbox.enqueue(&message));
+		EXPECT_FALSE(mailbox.empty());
+		for (auto &message : messages)
+		{
+			EXPECT_TRUE(mailbox.try_dequeue(m));
+			EXPECT_EQ(&message, m);
+		}
+		EXPECT_TRUE(mailbox.empty());
+		EXPECT_FALSE(mailbox.try_dequeue(m));
+
+		// Messages are dequeued in order of each producer.
+		constexpr int count = 10000;
+		std::vector<std::jthread> producers;
+		for (auto i = 0; i < 4; ++i)
+		{
+			producers.emplace_back([&mailbox, i]()
+								   {
+				for (auto j = 0; j < count; ++j) {
+					mailbox.enqueue(new message_t{{}, i, j});
+				} });
+		}
+		std::vector<int> sequences(4u);
+		auto ordered = true;
+		for (auto n = 0; n < 4 * count; ++n)
+		{
+			ASSERT_TRUE(mailbox.dequeue(m));
+			ordered = ordered && m->sequence == sequences[m->producer]++;
+			delete m;
+		}
+		EXPECT_TRUE(ordered);
+		producers.clear();
+		EXPECT_TRUE(mailbox.empty());
+	}
+	{
+		// The terminate() wakes the consumer up, and leaves the messages.
+		xxx::mpsc_mailbox<message_t> mailbox;
+		std::jthread terminator{[&mailbox]()
+								{
+			std::this_thread::sleep_for(std::chrono::milliseconds{10});
+			mailbox.terminate(); }};
+		message_t *m = nullptr;
+		EXPECT_FALSE(mailbox.dequeue(m));
+		message_t message{};
+		EXPECT_FALSE(mailbox.enqueue(&message));
+		EXPECT_TRUE(mailbox.empty());
+	}
+}
+
+#if defined(xxx_posix)
+
+TEST(test_queue, Pollable_queue)
+{
+	xxx::pollable_queue<int> queue;
+	auto const readable = [&queue](int timeout)
+	{
+		::pollfd fd{queue.native_handle(), POLLIN, 0};
+		return ::poll(&fd, 1u, timeout) == 1 && (fd.revents & POLLIN) != 0;
+	};
+	EXPECT_FALSE(readable(0));
+	EXPECT_TRUE(queue.enqueue(1));
+	EXPECT_TRUE(queue.enqueue_bulk(std::vector{2, 3, 4}));
+	EXPECT_TRUE(readable(0));
+
+	// The descriptor stays readable until the queue is found empty.
+	int n;
+	EXPECT_TRUE(queue.try_dequeue(n));
+	EXPECT_EQ(1, n);
+	EXPECT_TRUE(readable(0));
+	std::vector<int> events;
+	EXPECT_EQ(3u, queue.try_dequeue_bulk(std::back_inserter(events), 16u));
+	EXPECT_EQ((std::vector{2, 3, 4}), events);
+	EXPECT_FALSE(readable(0));
+
+	// An event loop drains the events of producers.
+	constexpr int count = 10000;
+	std::vector<std::jthread> producers;
+	for (auto i = 0; i < 4; ++i)
+	{
+		producers.emplace_back([&queue]()
+							   {
+			for (auto j = 0; j < count; ++j) queue.enqueue(j); });
+	}
+	std::size_t consumed = 0u;
+	while (consumed < 4u * count)
+	{
+		ASSERT_TRUE(readable(1000));
+		events.clear();
+		consumed += queue.try_dequeue_bulk(std::back_inserter(events), 256u);
+	}
+	producers.clear();
+	EXPECT_FALSE(queue.try_dequeue(n));
+	EXPECT_FALSE(readable(0));
+
+	// The terminate() wakes the event loop up.
+	std::jthread terminator{[&queue]()
+							{
+		std::this_thread::sleep_for(std::chrono::milliseconds{10});
+		queue.terminate(); }};
+	EXPECT_TRUE(readable(1000));
+	EXPECT_TRUE(queue.terminated());
+	EXPECT_FALSE(queue.enqueue(0));
+	EXPECT_FALSE(queue.try_dequeue(n));
+	EXPECT_TRUE(readable(0));
+}
+
+#endif
+
 #if __has_include("sqlite3.h")
 
 TEST(test_db, Database)
@@ -1153,4 +2558,71 @@ TEST(test_db, Database)
 	EXPECT_FALSE(stmt3.fetch(id));
 }
 
+TEST(test_db, Logger)
+{
+	using namespace std::string_literals;
+	std::filesystem::path const path = "log.db";
+	if (std::filesystem::exists(path))
+	{
+		std::filesystem::remove(path);
+	}
+	auto &logger = xxx::log::logger("");
+	logger.set_level(xxx::log::level_t::Info);
+	logger.set_console(false);
+	logger.set_path("");
+
+	logger.set_database(path);
+	EXPECT_EQ(path, logger.database());
+	for (int i = 0; i < 1000; ++i)
+	{
+		logger.info("row " + std::to_string(i));
+	}
+	logger.err("last");
+	logger.debug("filtered");
+	logger.set_database("");
+	EXPECT_TRUE(logger.database().empty());
+
+	xxx::db::sl3::db_t db{path};
+	EXPECT_EQ(1001, db.select_one<int>("SELECT COUNT(*) FROM log").value_or(0));
+	auto stmt = db.execute("SELECT level, file, message FROM log ORDER BY rowid DESC");
+	int level{};
+	std::string file, message;
+	EXPECT_TRUE(stmt.fetch(level, file, message));
+	EXPECT_EQ(static_cast<int>(xxx::log::level_t::Error), level);
+	EXPECT_EQ("ut.cxx"s, file);
+	EXPECT_EQ("last"s, message);
+
+	// Records overflowing the queue are dropped and reported, except severe ones.
+	logger.set_database(path, "small", 2u);
+	for (int i = 0; i < 1000; ++i)
+	{
+		logger.info("row");
+		logger.err("err");
+	}
+	logger.set_database("");
+
+	xxx::db::sl3::db_t db2{path};
+	EXPECT_EQ(1000, db2.select_one<int>("SELECT COUNT(*) FROM small WHERE message = 'err'").value_or(0));
+	auto const rows = db2.select_one<int>("SELECT COUNT(*) FROM small WHERE message = 'row'").value_or(0);
+	auto stmt2 = db2.execute("SELECT message FROM small WHERE message LIKE 'dropped %'");
+	auto drops = 0;
+	for (std::string m; stmt2.fetch(m);)
+	{
+		drops += std::stoi(m.substr(8));
+	}
+	EXPECT_EQ(1000, rows + drops);
+
+	// The destructor inserts the queued records.
+	{
+		xxx::log::logger_t scoped{xxx::log::level_t::Info, "", "scoped", false};
+		scoped.set_database(path, "scoped");
+		for (int i = 0; i < 1000; ++i)
+		{
+			scoped.info("row");
+		}
+	}
+	xxx::db::sl3::db_t db3{path};
+	EXPECT_EQ(1000, db3.select_one<int>("SELECT COUNT(*) FROM scoped").value_or(0));
+}
+
 #endif
@@ -0,0 +1,82 @@
+///	@file
+///	@brief		Main entry of logrange.
+///	@details	Prints logs in a time range of log files.
+///				It seeks straight to the range with the time index beside the log file if exists.
+///	@pre		ISO/IEC 14882:2017
+///	@author		Mura
+///	@copyright	(C) 2023-, Mura. All rights reserved.
+
+#include <xxx/config.hxx>
+#include <xxx/exceptions.hxx>
+#include <xxx/logger.hxx>
+#include <xxx/xxx.hxx>
+
+#include <string_view>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+namespace {
+
+/// @brief	Gets the usage of this program.
+/// @param[in]	result		Result of this program. Zero means success. Negative value means an error.
+/// @return		String of the usage.
+std::string
+get_usage(int result = 0) {
+	if (0 < result) {
+		return "xxx logrange\n (c) 2023-, Mura."
+			   "\n[Usage] $ ./logrange  {options}  {log files}"
+			   "\n[Options]"
+			   "\n  -h,--help   : Shows this usage."
+			   "\n  -f:time     : Beginning of the range such as 2018-01-23T01:23:45+0900. (default: the beginning)"
+			   "\n  -t:time     : End of the range (exclusive). (default: the end)";
+	} else {
+		return "xxx logrange\n (c) 2023-, Mura.\n\nAn error occurred.";
+	}
+}
+
+static char const Unexpected[]{"Unexpected exception occurred"};
+}	 // namespace
+
+int main(int ac, char** av) {
+	try {
+		xxx::initialize_cpp();
+
+		auto const [result, options] = xxx::config::get_options(ac, av);
+		if (result != 0) {
+			std::clog << get_usage(result) << std::endl;
+			return result;
+		}
+		if (! options.contains("")) {
+			std::clog << get_usage(1) << std::endl;
+			return 1;
+		}
+
+		auto const get_time = [&options](std::string const& name, std::chrono::system_clock::time_point const& def) {
+			if (! options.contains(name)) return def;
+			auto const time = xxx::log::parse_timestamp(options.at(name).at(0));
+			if (! time) throw std::invalid_argument(name);
+			return *time;
+		};
+		auto const from = get_time("f", std::chrono::system_clock::time_point::min());
+		auto const to	= get_time("t", std::chrono::system_clock::time_point::max());
+
+		for (auto const& path: options.at("")) {
+			xxx::log::read_logs(path, from, to, [](std::string_view const line) { std::cout << line << '\n'; });
+		}
+		std::cout << std::flush;
+
+		return 0;
+	} catch (std::exception const& e) {
+		xxx::suppress_exceptions([&e]() {
+			std::clog << xxx::log::enclose(Unexpected, e.what()) << std::endl;
+		});
+	} catch (...) {
+		xxx::suppress_exceptions([]() {
+			std::clog << Unexpected << std::endl;
+		});
+	}
+	return -1;
+}
@@ -0,0 +1,247 @@
+///	@file
+///	@brief		xxx common library.
+///	@details	Broadcast ring buffer for a single producer and multiple consumers.
+///	@pre		ISO/IEC 14882:2020 or higher
+///	@author		Mura
+///	@copyright	(C) 2023-, Mura. All rights reserved. (MIT License)
+
+#ifndef xxx_BROADCAST_RING_HXX_
+#define xxx_BROADCAST_RING_HXX_
+
+#include <xxx/exceptions.hxx>
+#include <xxx/queue.hxx>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace xxx {
+
+///	@brief	Ring buffer which delivers every event to every consumer.
+///		A single producer writes events into the slots in place, and publishes them by advancing its cursor.
+///		Each consumer reads the events by reference and advances its own sequence,
+///		so that the events are never copied per consumer.
+///		A consumer can depend on other consumers, and then it reads only the events they have consumed.
+///		The producer reuses a slot after all the consumers consume it.
+///		Both of the producer and the consumers claim events in batches to take each lock-free step once per batch.
+///		The terminate() behaves the same as the xxx::queue.
+template<typename T>
+class broadcast_ring {
+	static_assert(std::is_default_constructible_v<T>);
+
+public:
+	///	@brief	Consumer, which is used by a thread at a time.
+	class consumer_t {
+	public:
+		///	@brief	Gets the sequence.
+		///	@return		The number of events consumed.
+		std::uint64_t sequence() const noexcept { return sequence_.load(std::memory_order_acquire); }
+
+	private:
+		friend class broadcast_ring;
+
+		consumer_t(consumer_t const&)			 = delete;
+		consumer_t& operator=(consumer_t const&) = delete;
+
+		explicit consumer_t(std::vector<consumer_t const*> dependencies) :
+			sequence_{}, dependencies_{std::move(dependencies)} {}
+
+		alignas(cache_line_size) std::atomic<std::uint64_t> sequence_;	   ///< The number of events consumed.
+		std::vector<consumer_t const*> const dependencies_;				   ///< Consumers to precede this one.
+	};
+
+	///	@brief	Adds a consumer.
+	///		Consumers have to be added before publishing any event.
+	///	@param[in]	dependencies	Consumers which consume events before the new consumer.
+	///	@return		The consumer.
+	///	@throw		If an event has been published, it throws a logic error exception.
+	consumer_t& subscribe(std::initializer_list<consumer_t const*> dependencies = {}) {
+		if (0u < cursor_.load()) throw std::logic_error(__func__);
+		for (auto const* dependency: dependencies) {
+			validate_argument(std::ranges::any_of(consumers_, [dependency](auto const& consumer) { return consumer.get() == dependency; }));
+		}
+		consumers_.reserve(consumers_.size() + 1u);
+		return *consumers_.emplace_back(new consumer_t{std::vector<consumer_t const*>(dependencies)});
+	}
+	///	@brief	Publishes an event.
+	///		If the ring is full, this method waits for the slowest consumer.
+	///	@param[in]	t	The event.
+	///	@return		It returns true if published; otherwise, it returns false.
+	bool publish(T const& t) {
+		return publish_bulk(1u, [&t](T& slot, std::size_t) { slot = t; });
+	}
+	///	@brief	Publishes an event.
+	///		If the ring is full, this method waits for the slowest consumer.
+	///	@param[in]	t	The event.
+	///	@return		It returns true if published; otherwise, it returns false.
+	bool publish(T&& t) {
+		return publish_bulk(1u, [&t](T& slot, std::size_t) { slot = std::move(t); });
+	}
+	///	@brief	Claims slots, writes events into them in place, and publishes them at once.
+	///		If the ring does not have enough room, this method waits for the slowest consumer.
+	///		Only a single thread can publish events.
+	///	@param[in]	n	The number of events, up to the capacity.
+	///	@param[in]	f	Function called with each slot and its index in the batch to write an event.
+	///					If it throws an exception, none of the events is published.
+	///	@return		It returns true if published; otherwise, it returns false.
+	template<typename F>
+	bool publish_bulk(std::size_t n, F&& f) {
+		validate_argument(0u < n && n <= capacity());
+
+		auto const begin = cursor_.load(std::memory_order_relaxed);
+		auto const end	 = begin + n;
+		if (! wait_room_(end)) return false;
+		for (auto i = begin; i < end; ++i) {
+			f(slots_[i & mask_], static_cast<std::size_t>(i - begin));
+		}
+		cursor_.store(end, std::memory_order_release);
+		wake_();
+		return true;
+	}
+	///	@brief	Consumes the events available at once.
+	///		If no event is available for the consumer, this method waits for the producer or its dependencies.
+	///	@param[in]	consumer	The consumer.
+	///	@param[in]	f			Function called with each event.
+	///							If it throws an exception, the event is skipped and the exception is rethrown.
+	///	@return		The number of events consumed, or zero if terminated.
+	template<typename F>
+	std::size_t consume(consumer_t& consumer, F&& f) {
+		auto const begin = consumer.sequence_.load(std::memory_order_relaxed);
+		for (;;) {
+			if (terminated()) return 0u;
+			if (begin < available_(consumer)) break;
+
+			// Registers as a waiter before checking the sequences again,
+			// so that the one who advances surely sees the waiter or this consumer surely sees the events.
+			auto const signal = signal_.load();
+			waiters_.fetch_add(1u);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (available_(consumer) <= begin && ! terminated()) {
+				signal_.wait(signal);
+			}
+			waiters_.fetch_sub(1u);
+		}
+		return consume_(consumer, begin, std::forward<F>(f));
+	}
+	///	@brief	Consumes the events available at once if any.
+	///	@param[in]	consumer	The consumer.
+	///	@param[in]	f			Function called with each event.
+	///							If it throws an exception, the event is skipped and the exception is rethrown.
+	///	@return		The number of events consumed.
+	template<typename F>
+	std::size_t try_consume(consumer_t& consumer, F&& f) {
+		if (terminated()) return 0u;
+		return consume_(consumer, consumer.sequence_.load(std::memory_order_relaxed), std::forward<F>(f));
+	}
+	///	@brief	Terminates this ring.
+	///		Waiting producer and consumers return, and the events left are discarded.
+	void terminate() noexcept {
+		finished_.store(true);
+		signal_.fetch_add(1u);
+		signal_.notify_all();
+	}
+	///	@brief	Gets the cursor.
+	///	@return		The number of events published.
+	std::uint64_t cursor() const noexcept { return cursor_.load(std::memory_order_acquire); }
+	///	@brief	Gets the capacity.
+	///	@return		The number of slots.
+	std::size_t capacity() const noexcept { return mask_ + 1u; }
+	///	@brief	Is this ring terminated?
+	///	@return		It returns true if the ring has been terminated; otherwise, it returns false.
+	bool terminated() const noexcept { return finished_.load(); }
+
+	///	@brief	Constructor.
+	///	@param[in]	capacity	The number of slots, which is rounded up to a power of two.
+	explicit broadcast_ring(std::size_t capacity) :
+		mask_{std::bit_ceil(std::max(capacity, std::size_t{2u})) - 1u}, slots_{std::make_unique<T[]>(mask_ + 1u)}, consumers_{}, gate_{}, cursor_{}, signal_{}, waiters_{}, finished_{} {}
+	///	@brief	Destructor.
+	~broadcast_ring() noexcept { terminate(); }
+
+private:
+	broadcast_ring(broadcast_ring const&)			 = delete;
+	broadcast_ring& operator=(broadcast_ring const&) = delete;
+
+	// Gets the sequence up to which the consumer can consume.
+	std::uint64_t available_(consumer_t const& consumer) const noexcept {
+		auto available = cursor_.load(std::memory_order_acquire);
+		for (auto const* dependency: consumer.dependencies_) {
+			available = std::min(available, dependency->sequence_.load(std::memory_order_acquire));
+		}
+		return available;
+	}
+	// Gets the sequence of the slowest consumer.
+	std::uint64_t slowest_(std::uint64_t cursor) const noexcept {
+		for (auto const& consumer: consumers_) {
+			cursor = std::min(cursor, consumer->sequence_.load(std::memory_order_acquire));
+		}
+		return cursor;
+	}
+	// Waits until the slots before the end are free.
+	bool wait_room_(std::uint64_t end) {
+		// The sequence of the slowest consumer is cached, because it is checked only when the cache is too old.
+		while (gate_ + capacity() < end) {
+			if (terminated()) return false;
+			gate_ = slowest_(end - capacity());
+			if (end <= gate_ + capacity()) break;
+
+			auto const signal = signal_.load();
+			waiters_.fetch_add(1u);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (slowest_(end - capacity()) + capacity() < end && ! terminated()) {
+				signal_.wait(signal);
+			}
+			waiters_.fetch_sub(1u);
+		}
+		return ! terminated();
+	}
+	template<typename F>
+	std::size_t consume_(consumer_t& consumer, std::uint64_t begin, F&& f) {
+		auto const end = available_(consumer);
+		if (end <= begin) return 0u;
+
+		// Advances the sequence even if the f throws an exception.
+		struct advance_t {
+			broadcast_ring& ring;
+			consumer_t&		consumer;
+			std::uint64_t	next;
+			~advance_t() {
+				consumer.sequence_.store(next, std::memory_order_release);
+				ring.wake_();
+			}
+		} advance{*this, consumer, begin};
+		while (advance.next < end) {
+			f(std::as_const(slots_[advance.next++ & mask_]));
+		}
+		return static_cast<std::size_t>(end - begin);
+	}
+	// Wakes the producer and the consumers waiting for the sequences.
+	void wake_() noexcept {
+		// Pairs with the fence of the waiter.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (0u < waiters_.load(std::memory_order_relaxed)) {
+			signal_.fetch_add(1u);
+			signal_.notify_all();
+		}
+	}
+
+	std::size_t const										 mask_;		   ///< Mask of indices of the slots.
+	std::unique_ptr<T[]>									 slots_;	   ///< Slots.
+	std::vector<std::unique_ptr<consumer_t>>				 consumers_;   ///< Consumers.
+	std::uint64_t											 gate_;		   ///< Cache of the sequence of the slowest consumer.
+	alignas(cache_line_size) std::atomic<std::uint64_t>		 cursor_;	   ///< The number of events published.
+	alignas(cache_line_size) std::atomic<std::uint32_t>		 signal_;	   ///< Epoch for the producer and the consumers to wait.
+	std::atomic<std::uint32_t>								 waiters_;	   ///< The number of waiting producer and consumers.
+	std::atomic<bool>										 finished_;	   ///< Finished flag.
+};
+
+}	 // namespace xxx
+
+#endif	  // xxx_BROADCAST_RING_HXX_
@@ -0,0 +1,177 @@
+///	@file
+///	@brief		xxx common library.
+///	@details	Event queue for coroutines.
+///	@pre		ISO/IEC 14882:2020 or higher
+///	@author		Mura
+///	@copyright	(C) 2023-, Mura. All rights reserved. (MIT License)
+
+#ifndef xxx_CO_QUEUE_HXX_
+#define xxx_CO_QUEUE_HXX_
+
+#include <xxx/exceptions.hxx>
+
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace xxx {
+
+///	@brief	Event queue which coroutines can await.
+///		A consumer suspends on `co_await queue.dequeue()` without blocking its thread,
+///		and a producer hands the event to the first waiting consumer and resumes it on the scheduler.
+///		The enqueue() and terminate() behave the same as the xxx::queue,
+///		but it does not wrap the xxx::queue, whose consumers block their threads;
+///		waiting coroutines are linked in their awaiters instead.
+template<typename T>
+class co_queue {
+public:
+	using scheduler_t = std::function<void(std::coroutine_handle<>)>;	 ///< Resumes a coroutine on an executor.
+
+	///	@brief	Awaiter of an event.
+	///		The `co_await` returns the event, or nullopt if the queue is terminated.
+	class awaiter_t {
+	public:
+		///	@brief	Never ready without the lock; see await_suspend().
+		///	@return		It always returns false.
+		bool await_ready() const noexcept { return false; }
+		///	@brief	Takes an event if any, or registers the coroutine as a waiter.
+		///	@param[in]	handle	The awaiting coroutine.
+		///	@return		It returns true if the coroutine waits; otherwise, it returns false.
+		bool await_suspend(std::coroutine_handle<> handle) {
+			std::lock_guard lock{queue_.mutex_};
+			if (! queue_.queue_.empty()) {
+				result_.emplace(std::move(queue_.queue_.front()));	  // might cause an exception.
+				queue_.queue_.pop_front();
+				return false;
+			}
+			if (queue_.finished_) return false;
+
+			// Waits in first-in first-out order.
+			handle_ = handle;
+			(queue_.tail_ ? queue_.tail_->next_ : queue_.head_) = this;
+			queue_.tail_										 = this;
+			return true;
+		}
+		///	@brief	Gets the event.
+		///	@return		The event, or nullopt if the queue is terminated.
+		std::optional<T> await_resume() { return std::move(result_); }
+
+		///	@brief	Constructor.
+		///	@param[in]	queue	Queue to await.
+		explicit awaiter_t(co_queue& queue) noexcept :
+			queue_{queue}, result_{}, handle_{}, next_{} {}
+
+	private:
+		friend class co_queue;
+
+		awaiter_t(awaiter_t const&)			   = delete;
+		awaiter_t& operator=(awaiter_t const&) = delete;
+
+		co_queue&				queue_;	   ///< Queue.
+		std::optional<T>		result_;   ///< Dequeued event.
+		std::coroutine_handle<> handle_;   ///< Waiting coroutine.
+		awaiter_t*				next_;	   ///< Next waiter.
+	};
+
+	/// @brief 	Enqueues an event.
+	/// @param[in]	t	The event to push.
+	/// @return	It returns true if queued; otherwise, it returns false.
+	bool enqueue(T const& t) { return push_(t); }
+	/// @brief 	Enqueues an event.
+	/// @param[in]	t	The event to push.
+	/// @return	It returns true if queued; otherwise, it returns false.
+	bool enqueue(T&& t) { return push_(std::move(t)); }
+	/// @brief 	Dequeues an event.
+	///		If this queue is empty, the awaiting coroutine is suspended until a new event.
+	/// @return	Awaiter of the event.
+	awaiter_t dequeue() noexcept { return awaiter_t{*this}; }
+	/// @brief 	Terminates this queue.
+	///		Waiting consumers are resumed with nullopt, and the events left are discarded.
+	void terminate() noexcept {
+		for (auto* waiter = finish_(); waiter;) {
+			resume_(std::exchange(waiter, waiter->next_)->handle_);
+		}
+	}
+	/// @brief 	Is this queue empty?
+	/// @return		It returns true if the queue is empty; otherwise, it returns false.
+	bool empty() const noexcept {
+		std::lock_guard lock{mutex_};
+		return queue_.empty();
+	}
+	/// @brief 	Is this queue terminated?
+	/// @return		It returns true if the queue has been terminated; otherwise, it returns false.
+	bool terminated() const noexcept {
+		std::lock_guard lock{mutex_};
+		return finished_;
+	}
+
+	/// @brief 	Constructor.
+	/// @param[in]	scheduler	Function to resume a coroutine, or null to resume it on the producer's thread.
+	explicit co_queue(scheduler_t scheduler = nullptr) :
+		scheduler_{std::move(scheduler)}, mutex_{}, queue_{}, head_{}, tail_{}, finished_{} {}
+	/// @brief 	Destructor.
+	///		Waiting consumers are never resumed inside it, because they might touch this queue;
+	///		they are handed to the scheduler to resume with nullopt after it, or left suspended without the scheduler.
+	///		Call terminate() before it to resume them in place.
+	~co_queue() noexcept {
+		for (auto* waiter = finish_(); waiter;) {
+			auto const handle = std::exchange(waiter, waiter->next_)->handle_;
+			if (scheduler_) ignore_exceptions([this, handle]() { scheduler_(handle); });
+		}
+	}
+
+private:
+	co_queue(co_queue const&)			 = delete;
+	co_queue& operator=(co_queue const&) = delete;
+
+	// Terminates this queue, and takes the waiters out under the lock.
+	awaiter_t* finish_() noexcept {
+		std::lock_guard lock{mutex_};
+		finished_ = true;
+		queue_.clear();
+		tail_ = nullptr;
+		return std::exchange(head_, nullptr);
+	}
+	template<typename U>
+	bool push_(U&& u) {
+		awaiter_t* waiter{};
+		{
+			std::lock_guard lock{mutex_};
+			if (finished_) return false;
+			if (! head_) {
+				queue_.emplace_back(std::forward<U>(u));
+				return true;
+			}
+			// Hands the event to the first waiter.
+			waiter = head_;
+			waiter->result_.emplace(std::forward<U>(u));	// might cause an exception.
+			head_ = waiter->next_;
+			if (! head_) tail_ = nullptr;
+		}
+		resume_(waiter->handle_);
+		return true;
+	}
+	void resume_(std::coroutine_handle<> handle) noexcept {
+		if (scheduler_) {
+			try {
+				scheduler_(handle);
+				return;
+			} catch (...) {}
+		}
+		handle.resume();
+	}
+
+	scheduler_t const  scheduler_;	  ///< Function to resume a coroutine.
+	mutable std::mutex mutex_;		  ///< Mutex.
+	std::deque<T>	   queue_;		  ///< Queue.
+	awaiter_t*		   head_;		  ///< The first waiter.
+	awaiter_t*		   tail_;		  ///< The last waiter.
+	bool			   finished_;	  ///< Finished flag.
+};
+
+}	 // namespace xxx
+
+#endif	  // xxx_CO_QUEUE_HXX_
@@ -0,0 +1,324 @@
+///	@file
+///	@brief		xxx common library.
+///	@details	Delay queue on a hierarchical timing wheel.
+///	@pre		ISO/IEC 14882:2020 or higher
+///	@author		Mura
+///	@copyright	(C) 2023-, Mura. All rights reserved. (MIT License)
+
+#ifndef xxx_DELAY_QUEUE_HXX_
+#define xxx_DELAY_QUEUE_HXX_
+
+#include <xxx/exceptions.hxx>
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace xxx {
+
+///	@brief	Event queue delaying events until their deadlines.
+///		Pending events are kept in a hierarchical timing wheel;
+///		each level has 64 slots, and a slot of a higher level covers a whole rotation of the lower level.
+///		An event is put into the slot of its deadline at the lowest level which can hold it,
+///		and moved down to the lower levels as the time goes, so that enqueuing and canceling take constant time.
+///		The dequeue() and terminate() behave the same as the xxx::queue,
+///		except that the dequeue() waits until the deadline of an event comes.
+template<typename T>
+class delay_queue {
+public:
+	using clock_t  = std::chrono::steady_clock;	   ///< Clock of deadlines.
+	using handle_t = std::uint64_t;				   ///< Handle of an event to cancel.
+
+	/// @brief 	Enqueues an event to dequeue at the deadline.
+	/// @param[in]	deadline	Deadline.
+	/// @param[in]	t			The event to push.
+	/// @return	Handle of the event if queued; otherwise, nullopt.
+	std::optional<handle_t> enqueue_at(clock_t::time_point deadline, T const& t) { return push_(deadline, t); }
+	/// @brief 	Enqueues an event to dequeue at the deadline.
+	/// @param[in]	deadline	Deadline.
+	/// @param[in]	t			The event to push.
+	/// @return	Handle of the event if queued; otherwise, nullopt.
+	std::optional<handle_t> enqueue_at(clock_t::time_point deadline, T&& t) { return push_(deadline, std::move(t)); }
+	/// @brief 	Enqueues an event to dequeue after the delay.
+	/// @param[in]	delay	Delay.
+	/// @param[in]	t		The event to push.
+	/// @return	Handle of the event if queued; otherwise, nullopt.
+	template<typename Rep, typename Period>
+	std::optional<handle_t> enqueue_after(std::chrono::duration<Rep, Period> const& delay, T const& t) {
+		return push_(clock_t::now() + std::chrono::ceil<clock_t::duration>(delay), t);
+	}
+	/// @brief 	Enqueues an event to dequeue after the delay.
+	/// @param[in]	delay	Delay.
+	/// @param[in]	t		The event to push.
+	/// @return	Handle of the event if queued; otherwise, nullopt.
+	template<typename Rep, typename Period>
+	std::optional<handle_t> enqueue_after(std::chrono::duration<Rep, Period> const& delay, T&& t) {
+		return push_(clock_t::now() + std::chrono::ceil<clock_t::duration>(delay), std::move(t));
+	}
+	/// @brief 	Cancels an event.
+	/// @param[in]	handle	Handle of the event.
+	/// @return	It returns true if canceled; otherwise, it returns false because it has been dequeued.
+	bool cancel(handle_t handle) noexcept {
+		std::lock_guard lock{mutex_};
+		auto const index = static_cast<std::uint32_t>(handle);
+		if (nodes_.size() <= index) return false;
+		auto& node = nodes_[index];
+		if (! node.value || node.generation != static_cast<std::uint32_t>(handle >> 32u)) return false;
+		unlink_(index);
+		free_(index);
+		return true;
+	}
+	/// @brief 	Dequeues an event.
+	///		If no event reaches its deadline, this method waits for the deadline or a new event.
+	/// @param[in]	t	Next event.
+	/// @return	It returns true if dequeued; otherwise, it returns false.
+	bool dequeue(T& t) {
+		std::unique_lock lock{mutex_};
+		for (;;) {
+			if (finished_) return false;
+			advance_(floor_(clock_t::now()));
+			if (lists_[ready_].head != npos_) {
+				pop_(t);
+				pass_();
+				return true;
+			}
+			if (auto const next = next_tick_(); next == std::numeric_limits<std::uint64_t>::max()) {
+				condition_.wait(lock);
+			} else {
+				condition_.wait_until(lock, origin_ + resolution_ * next);
+			}
+		}
+	}
+	/// @brief 	Dequeues an event if any event reaches its deadline.
+	/// @param[in]	t	Next event.
+	/// @return	It returns true if dequeued; otherwise, it returns false.
+	bool try_dequeue(T& t) {
+		std::lock_guard lock{mutex_};
+		if (finished_) return false;
+		advance_(floor_(clock_t::now()));
+		if (lists_[ready_].head == npos_) return false;
+		pop_(t);
+		pass_();
+		return true;
+	}
+	/// @brief 	Terminates this queue.
+	///		Waiting consumers return false, and the events left are discarded.
+	void terminate() noexcept {
+		std::lock_guard lock{mutex_};
+		finished_.store(true);
+		nodes_.clear();
+		lists_.fill(list_t{});
+		occupied_.fill(0u);
+		free_list_ = npos_;
+		size_	   = 0u;
+		condition_.notify_all();
+	}
+	/// @brief 	Gets the number of events, including those before their deadlines.
+	/// @return		The number of events.
+	std::size_t size() const noexcept {
+		std::lock_guard lock{mutex_};
+		return size_;
+	}
+	/// @brief 	Is this queue empty?
+	/// @return		It returns true if the queue has no event; otherwise, it returns false.
+	bool empty() const noexcept { return size() == 0u; }
+	/// @brief 	Is this queue terminated?
+	/// @return		It returns true if the queue has been terminated; otherwise, it returns false.
+	bool terminated() const noexcept { return finished_.load(); }
+
+	/// @brief 	Constructor.
+	/// @param[in]	resolution	Resolution of deadlines; events are never dequeued before their deadlines,
+	///							but they might be dequeued later by up to the resolution.
+	explicit delay_queue(clock_t::duration resolution = std::chrono::milliseconds{1}) :
+		mutex_{}, condition_{}, resolution_{resolution}, origin_{clock_t::now()}, nodes_{}, free_list_{npos_}, lists_{}, occupied_{}, now_{}, size_{}, finished_{} {
+		validate_argument(clock_t::duration::zero() < resolution);
+	}
+	/// @brief 	Destructor.
+	~delay_queue() noexcept { terminate(); }
+
+private:
+	delay_queue(delay_queue const&)			   = delete;
+	delay_queue& operator=(delay_queue const&) = delete;
+
+	static constexpr std::size_t   slot_bits_ = 6u;							 ///< Bits of slots of a level.
+	static constexpr std::size_t   slots_	  = std::size_t{1u} << slot_bits_;	 ///< The number of slots of a level.
+	static constexpr std::size_t   levels_	  = 6u;							 ///< The number of levels.
+	static constexpr std::size_t   ready_	  = slots_ * levels_;			 ///< Index of the list of events past their deadlines.
+	static constexpr std::uint32_t npos_	  = std::numeric_limits<std::uint32_t>::max();	  ///< Null index.
+
+	///	@brief	Event and its links.
+	struct node_t {
+		std::optional<T> value;			///< Event, or nullopt if the node is free.
+		std::uint64_t	 deadline;		///< Deadline in ticks.
+		std::uint32_t	 prev;			///< Previous node in the list.
+		std::uint32_t	 next;			///< Next node in the list, or next free node.
+		std::uint32_t	 list;			///< Index of the list.
+		std::uint32_t	 generation;	///< Generation to tell handles of reused nodes.
+	};
+	///	@brief	Doubly linked list of nodes.
+	struct list_t {
+		std::uint32_t head{npos_};	  ///< The first node.
+		std::uint32_t tail{npos_};	  ///< The last node.
+	};
+
+	template<typename U>
+	std::optional<handle_t> push_(clock_t::time_point deadline, U&& u) {
+		std::lock_guard lock{mutex_};
+		if (finished_) return std::nullopt;
+
+		if (free_list_ == npos_) {
+			nodes_.emplace_back(node_t{std::nullopt, 0u, npos_, npos_, npos_, 1u});	   // might cause an exception.
+			free_list_ = static_cast<std::uint32_t>(nodes_.size() - 1u);
+		}
+		auto const index = free_list_;
+		auto&	   node	 = nodes_[index];
+		node.value.emplace(std::forward<U>(u));	   // might cause an exception.
+		free_list_	  = node.next;
+		node.deadline = ceil_(deadline);
+		place_(index);
+		++size_;
+		condition_.notify_one();
+		return (handle_t{node.generation} << 32u) | index;
+	}
+	// Pops the first event past its deadline under the lock.
+	void pop_(T& t) {
+		auto const index = lists_[ready_].head;
+		t				 = std::move(*nodes_[index].value);	   // might cause an exception.
+		unlink_(index);
+		free_(index);
+	}
+	// Passes the notification on to another consumer under the lock.
+	// A push wakes only one consumer, and it might take another event than the one it was woken for,
+	// then the others sleeping for later deadlines have to see the events ready or the earlier deadlines.
+	void pass_() noexcept {
+		if (0u < size_) condition_.notify_one();
+	}
+	// Frees an unlinked node.
+	void free_(std::uint32_t index) noexcept {
+		auto& node = nodes_[index];
+		node.value.reset();
+		++node.generation;
+		node.next  = free_list_;
+		free_list_ = index;
+		--size_;
+	}
+
+	// Converts a time point to ticks.
+	std::uint64_t floor_(clock_t::time_point time) const noexcept {
+		return time <= origin_ ? 0u : static_cast<std::uint64_t>((time - origin_) / resolution_);
+	}
+	std::uint64_t ceil_(clock_t::time_point time) const noexcept {
+		if (time <= origin_) return 0u;
+		auto const d = time - origin_;
+		return static_cast<std::uint64_t>(d / resolution_) + (d % resolution_ != clock_t::duration::zero() ? 1u : 0u);
+	}
+
+	// Puts a node into the slot of the lowest level which can hold it.
+	void place_(std::uint32_t index) noexcept {
+		auto const deadline = nodes_[index].deadline;
+		if (deadline <= now_) return link_(ready_, index);
+		for (std::size_t level{}; level + 1u < levels_; ++level) {
+			// The deadline is in the current rotation of the level.
+			if (((deadline ^ now_) >> (slot_bits_ * (level + 1u))) == 0u) {
+				return link_(level * slots_ + ((deadline >> (slot_bits_ * level)) & (slots_ - 1u)), index);
+			}
+		}
+		// The top level wraps around, and the events beyond it are moved again at the last slot.
+		auto const shift = slot_bits_ * (levels_ - 1u);
+		auto const ahead = std::min((deadline >> shift) - (now_ >> shift), std::uint64_t{slots_ - 1u});
+		link_((levels_ - 1u) * slots_ + (((now_ >> shift) + ahead) & (slots_ - 1u)), index);
+	}
+	// Gets the next tick when a slot has to be handled.
+	std::uint64_t next_tick_() const noexcept {
+		auto next = std::numeric_limits<std::uint64_t>::max();
+		for (std::size_t level{}; level < levels_; ++level) {
+			auto const occupied = occupied_[level];
+			if (occupied == 0u) continue;
+
+			auto const shift = slot_bits_ * level;
+			auto const group = now_ >> shift;
+			auto const slot	 = group & (slots_ - 1u);
+			if (level + 1u < levels_) {
+				// Slots of the lower levels are always ahead of the current one.
+				auto const ahead = occupied & ~((std::uint64_t{2u} << slot) - 1u);
+				if (ahead != 0u) {
+					next = std::min(next, (group - slot + static_cast<std::uint64_t>(std::countr_zero(ahead))) << shift);
+				}
+			} else {
+				next = std::min(next, (group + static_cast<std::uint64_t>(std::countr_zero(std::rotr(occupied, static_cast<int>(slot))))) << shift);
+			}
+		}
+		return next;
+	}
+	// Advances the wheel to the tick, and moves events past their deadlines to the ready list.
+	void advance_(std::uint64_t tick) noexcept {
+		while (now_ < tick) {
+			auto const next = next_tick_();
+			if (tick < next) break;
+			now_ = next;
+
+			// Moves the events of the higher levels down when their rotations come.
+			for (auto level = levels_ - 1u; 0u < level; --level) {
+				auto const shift = slot_bits_ * level;
+				if ((now_ & ((std::uint64_t{1u} << shift) - 1u)) == 0u) {
+					cascade_(level * slots_ + ((now_ >> shift) & (slots_ - 1u)));
+				}
+			}
+			cascade_(now_ & (slots_ - 1u));
+		}
+		now_ = std::max(now_, tick);
+	}
+	// Places the events of a slot again.
+	void cascade_(std::size_t list) noexcept {
+		for (auto index = lists_[list].head; index != npos_;) {
+			auto const next = nodes_[index].next;
+			unlink_(index);
+			place_(index);
+			index = next;
+		}
+	}
+
+	void link_(std::size_t list, std::uint32_t index) noexcept {
+		auto& node = nodes_[index];
+		auto& l	   = lists_[list];
+		node.list  = static_cast<std::uint32_t>(list);
+		node.prev  = l.tail;
+		node.next  = npos_;
+		(l.tail == npos_ ? l.head : nodes_[l.tail].next) = index;
+		l.tail											  = index;
+		if (list < ready_) occupied_[list / slots_] |= std::uint64_t{1u} << (list % slots_);
+	}
+	void unlink_(std::uint32_t index) noexcept {
+		auto&	   node = nodes_[index];
+		auto const list = std::size_t{node.list};
+		auto&	   l	= lists_[list];
+		(node.prev == npos_ ? l.head : nodes_[node.prev].next) = node.next;
+		(node.next == npos_ ? l.tail : nodes_[node.next].prev) = node.prev;
+		if (list < ready_ && l.head == npos_) occupied_[list / slots_] &= ~(std::uint64_t{1u} << (list % slots_));
+	}
+
+	mutable std::mutex						 mutex_;		///< Mutex.
+	std::condition_variable					 condition_;	///< Condition for consumers to wait.
+	clock_t::duration const					 resolution_;	///< Duration of a tick.
+	clock_t::time_point const				 origin_;		///< Time of the tick zero.
+	std::vector<node_t>						 nodes_;		///< Nodes.
+	std::uint32_t							 free_list_;	///< The first free node.
+	std::array<list_t, slots_ * levels_ + 1u> lists_;		///< Slots of each level and the ready list.
+	std::array<std::uint64_t, levels_>		 occupied_;		///< Bits of non-empty slots of each level.
+	std::uint64_t							 now_;			///< The current tick.
+	std::size_t								 size_;			///< The number of events.
+	std::atomic<bool>						 finished_;		///< Finished flag.
+};
+
+}	 // namespace xxx
+
+#endif	  // xxx_DELAY_QUEUE_HXX_
@@ -0,0 +1,123 @@
+///	@file
+///	@brief		xxx common library.
+///	@details	Event queue persisted in memory-mapped files.
+///	@pre		ISO/IEC 14882:2020 or higher
+///	@author		Mura
+///	@copyright	(C) 2023-, Mura. All rights reserved. (MIT License)
+
+#ifndef xxx_DURABLE_QUEUE_HXX_
+#define xxx_DURABLE_QUEUE_HXX_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace xxx {
+
+///	@brief	Event queue persisted in memory-mapped files, which survives restarts.
+///		Serialized events are appended to a log of fixed-size segment files in a directory,
+///		and the consumer offset is kept in the directory, too.
+///		Appends are flushed to the storage together every commit interval, or at once by commit().
+///		Segments which all the events have been dequeued from are recycled for later appends.
+///		On construction, it scans the log sequentially from the consumer offset to find the events left.
+///		The enqueue() and dequeue() behave the same as the xxx::queue,
+///		but the terminate() keeps the events left in the files for the next run.
+///		If the process crashes, the events dequeued after the last commit are dequeued again.
+class durable_queue_t {
+public:
+	///	@brief	Enqueues an event.
+	///	@param[in]	event	Serialized event.
+	///	@return		It returns true if queued; otherwise, it returns false.
+	///	@throw		If the event is too large for a segment, it throws an invalid argument exception.
+	bool enqueue(std::string_view event);
+	///	@brief	Dequeues an event.
+	///		If this queue is empty, this method waits a new event.
+	///	@param[out]	event	Next serialized event.
+	///	@return		It returns true if dequeued; otherwise, it returns false.
+	bool dequeue(std::string& event);
+	///	@brief	Dequeues an event if this queue is not empty.
+	///	@param[out]	event	Next serialized event.
+	///	@return		It returns true if dequeued; otherwise, it returns false.
+	bool try_dequeue(std::string& event);
+	///	@brief	Flushes the events enqueued and the consumer offset to the storage at once, and waits for them.
+	///	@throw		If the flush failed, it throws a system error exception; the committer keeps retrying.
+	void commit();
+	///	@brief	Terminates this queue.
+	///		Waiting consumers return false, and the events left are flushed to the storage.
+	void terminate() noexcept;
+	///	@brief	Gets the number of events.
+	///	@return		The number of events.
+	std::size_t size() const noexcept;
+	///	@brief	Is this queue empty?
+	///	@return		It returns true if the queue is empty; otherwise, it returns false.
+	bool empty() const noexcept { return size() == 0u; }
+	///	@brief	Is this queue terminated?
+	///	@return		It returns true if the queue has been terminated; otherwise, it returns false.
+	bool terminated() const noexcept { return finished_.load(); }
+
+	///	@brief	Constructor.
+	///		It opens the log in the directory, or creates a new log if the directory has no log.
+	///	@param[in]	directory		Directory of the files.
+	///	@param[in]	segment_size	Size of a segment file in bytes, which is a multiple of 8.
+	///	@param[in]	interval		Commit interval.
+	///	@throw		If the files were failed to open, it throws a system error exception.
+	explicit durable_queue_t(std::filesystem::path directory, std::size_t segment_size = std::size_t{64u} << 20u, std::chrono::milliseconds interval = std::chrono::milliseconds{10});
+	///	@brief	Destructor.
+	~durable_queue_t() noexcept;
+
+private:
+	durable_queue_t(durable_queue_t const&)			   = delete;
+	durable_queue_t& operator=(durable_queue_t const&) = delete;
+
+	class segment_t;
+
+	void open_();
+	std::shared_ptr<segment_t> acquire_(std::uint64_t number);
+	void recycle_(std::uint64_t number) noexcept;
+	void pop_(std::string& event);
+	void run_() noexcept;
+	bool commit_(std::unique_lock<std::mutex>& lock);
+	std::filesystem::path get_path_(std::uint64_t number) const;
+
+	std::filesystem::path const							  directory_;	   ///< Directory of the files.
+	std::size_t const									  segment_size_;   ///< Size of a new segment.
+	std::chrono::milliseconds const						  interval_;	   ///< Commit interval.
+	mutable std::mutex									  mutex_;		   ///< Mutex.
+	std::condition_variable								  condition_;	   ///< Condition for consumers to wait.
+	std::condition_variable								  committer_;	   ///< Condition for the committer to wait.
+	std::condition_variable								  committed_;	   ///< Condition for commit() to wait.
+	std::unique_ptr<segment_t>							  offset_;		   ///< File of the consumer offset.
+	std::shared_ptr<segment_t>							  head_;		   ///< Segment to dequeue.
+	std::uint64_t										  head_number_;	   ///< Number of the segment to dequeue.
+	std::size_t											  read_;		   ///< Offset to dequeue in the head segment.
+	std::shared_ptr<segment_t>							  tail_;		   ///< Segment to append.
+	std::uint64_t										  tail_number_;	   ///< Number of the segment to append.
+	std::size_t											  write_;		   ///< Offset to append in the tail segment.
+	std::size_t											  flushed_;		   ///< Offset flushed in the tail segment.
+	std::vector<std::pair<std::shared_ptr<segment_t>, std::size_t>> sealed_;	   ///< Segments filled but not flushed, and their offsets flushed.
+	std::vector<std::uint64_t>							  retired_;		   ///< Numbers of segments dequeued, which are recycled after the next commit.
+	std::vector<std::filesystem::path>					  spares_;		   ///< Segment files to recycle.
+	std::size_t											  count_;		   ///< The number of events.
+	std::uint64_t										  generation_;	   ///< Generation of the last commit started.
+	std::uint64_t										  synced_;		   ///< Generation of the last commit succeeded.
+	std::uint64_t										  attempts_;	   ///< The number of commits tried.
+	std::error_code										  error_;		   ///< Error of the last commit.
+	bool												  dirty_;		   ///< Whether the log or the offset has been updated since the last commit.
+	bool												  urgent_;		   ///< Whether commit() is waiting.
+	std::atomic<bool>									  finished_;	   ///< Finished flag.
+	std::thread											  thread_;		   ///< Committer thread.
+};
+
+}	 // namespace xxx
+
+#endif	  // xxx_DURABLE_QUEUE_HXX_
@@ -0,0 +1,152 @@
+///	@file
+///	@brief		xxx common library.
+///	@details	Thread pool executing tasks with work stealing.
+///	@pre		ISO/IEC 14882:2020 or higher
+///	@author		Mura
+///	@copyright	(C) 2023-, Mura. All rights reserved. (MIT License)
+
+#ifndef xxx_EXECUTOR_HXX_
+#define xxx_EXECUTOR_HXX_
+
+#include <xxx/queue.hxx>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace xxx {
+
+///	@brief	Thread pool executing tasks.
+///		Each worker has its own deque of tasks; it takes the newest task of its own,
+///		and steals the oldest task of another worker when its own deque is empty.
+///		Tasks posted from a worker go to its own deque, and the others go to the shared deque.
+class executor_t {
+public:
+	using task_t = std::function<void()>;	 ///< Task.
+
+	///	@brief	Posts a task.
+	///	@param[in]	task	Task to execute.
+	///	@return		It returns true if posted; otherwise, it returns false because terminated.
+	bool post(task_t task);
+	///	@brief	Submits a task to get its result.
+	///	@param[in]	f		Function to execute.
+	///	@param[in]	args	Arguments of the function.
+	///	@return		Future of the result.
+	///				If this executor has been terminated, the future has std::future_error of broken promise.
+	template<typename F, typename... Args>
+	auto submit(F&& f, Args&&... args) -> std::future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>> {
+		using result_t = std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>;
+
+		// The std::function requires copyable functions, so that the task is shared.
+		auto task = std::make_shared<std::packaged_task<result_t()>>(
+				[f = std::forward<F>(f), ... args = std::forward<Args>(args)]() mutable { return std::invoke(std::move(f), std::move(args)...); });
+		auto future = task->get_future();
+		post([task]() { (*task)(); });
+		return future;
+	}
+	///	@brief	Calls the function with each index of the range in parallel, and waits for all of them.
+	///		The calling thread executes tasks, too, while waiting,
+	///		so that it can be called from a task.
+	///	@param[in]	begin	The first index.
+	///	@param[in]	end		The index next to the last.
+	///	@param[in]	f		Function called with an index.
+	///	@param[in]	grain	The number of indices per task, or zero to divide the range by the number of workers.
+	///	@exception	The first exception thrown by the @p f if any.
+	template<typename F>
+	void parallel_for(std::size_t begin, std::size_t end, F const& f, std::size_t grain = 0u) {
+		if (end <= begin) return;
+		if (grain == 0u) {
+			grain = std::max(std::size_t{1u}, (end - begin + workers_.size() * 4u - 1u) / (workers_.size() * 4u));
+		}
+
+		struct state_t {
+			std::atomic<std::size_t> remaining;	   ///< The number of chunks not finished.
+			std::mutex				 mutex;		   ///< Mutex to store the exception.
+			std::exception_ptr		 exception;	   ///< The first exception.
+		};
+		auto const chunks = (end - begin + grain - 1u) / grain;
+		auto const state  = std::make_shared<state_t>();
+		state->remaining.store(chunks);
+
+		auto const chunk = [state, &f, begin, end, grain](std::size_t n) {
+			try {
+				for (auto i = begin + n * grain, last = std::min(end, i + grain); i < last; ++i) {
+					f(i);
+				}
+			} catch (...) {
+				std::lock_guard lock{state->mutex};
+				if (! state->exception) state->exception = std::current_exception();
+			}
+			state->remaining.fetch_sub(1u);
+		};
+		for (std::size_t n{1u}; n < chunks; ++n) {
+			if (! post([chunk, n]() { chunk(n); })) {
+				chunk(n);	 // terminated
+			}
+		}
+		chunk(0u);
+
+		while (0u < state->remaining.load()) {
+			if (! run_one_()) std::this_thread::yield();
+		}
+		if (state->exception) std::rethrow_exception(state->exception);
+	}
+	///	@brief	Terminates this executor.
+	///		It stops accepting tasks, waits for the workers to execute the tasks already posted, and joins them.
+	///		If it is called from a task, it returns without waiting, and the destructor joins the workers.
+	void terminate() noexcept;
+	///	@brief	Is this executor terminated?
+	///	@return		It returns true if it has been terminated; otherwise, it returns false.
+	bool terminated() const noexcept { return finished_.load(); }
+	///	@brief	Gets the number of workers.
+	///	@return		The number of workers.
+	std::size_t size() const noexcept { return workers_.size(); }
+
+	///	@brief	Constructor.
+	///	@param[in]	threads		The number of workers, or zero to use the number of hardware threads.
+	///	@param[in]	pinned		Whether each worker is pinned to a CPU.
+	explicit executor_t(std::size_t threads = 0u, bool pinned = false);
+	///	@brief	Destructor.
+	///		It must not be called from a task of this executor.
+	~executor_t() noexcept;
+
+private:
+	executor_t(executor_t const&)			 = delete;
+	executor_t& operator=(executor_t const&) = delete;
+
+	///	@brief	Worker.
+	struct alignas(cache_line_size) worker_t {
+		std::mutex		   mutex;	  ///< Mutex of the tasks.
+		std::deque<task_t> tasks;	  ///< Tasks; the owner takes the back, and the others steal the front.
+		std::thread		   thread;	  ///< Thread.
+	};
+
+	void run_(std::size_t index, bool pinned) noexcept;
+	bool run_one_();
+	bool take_(std::size_t index, task_t& task);
+	void wake_() noexcept;
+
+	std::vector<std::unique_ptr<worker_t>> workers_;	 ///< Workers.
+	std::mutex							   mutex_;		 ///< Mutex of the shared tasks.
+	std::deque<task_t>					   tasks_;		 ///< Shared tasks posted from other threads.
+	std::atomic<std::size_t>			   pending_;	 ///< The number of tasks not started.
+	std::atomic<std::uint32_t>			   signal_;		 ///< Epoch for idle workers to wait.
+	std::atomic<std::uint32_t>			   sleepers_;	 ///< The number of idle workers.
+	std::atomic<bool>					   finished_;	 ///< Finished flag.
+	std::once_flag						   joined_;		 ///< Flag to join the workers only once.
+};
+
+}	 // namespace xxx
+
+#endif	  // xxx_EXECUTOR_HXX_
@@ -0,0 +1,88 @@
+///	@file
+///	@brief		xxx common library.
+///	@details	Thread pool executing tasks in order of each key.
+///	@pre		ISO/IEC 14882:2020 or higher
+///	@author		Mura
+///	@copyright	(C) 2023-, Mura. All rights reserved. (MIT License)
+
+#ifndef xxx_KEYED_EXECUTOR_HXX_
+#define xxx_KEYED_EXECUTOR_HXX_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace xxx {
+
+///	@brief	Thread pool executing tasks of the same key one by one in order, and tasks of different keys in parallel.
+///		Tasks of each key are queued in a strand, and strands which have tasks wait in a shared run queue of keys.
+///		A worker takes the first strand in the run queue, and executes its tasks up to the quantum;
+///		then the strand goes back to the end of the run queue if it still has tasks.
+///		Therefore a busy key never stalls the other keys, and it moves to any idle worker without breaking its order.
+///		Keys are identified by their hash values, so that keys colliding with each other share a strand.
+class keyed_executor_t {
+public:
+	using task_t = std::function<void()>;	 ///< Task.
+
+	///	@brief	Posts a task.
+	///	@tparam		K		Type of key.
+	///	@tparam		H		Hash function of the key.
+	///	@param[in]	key		Key of the task, which is executed after the tasks of the same key posted before.
+	///	@param[in]	task	Task to execute.
+	///	@return		It returns true if posted; otherwise, it returns false because terminated.
+	template<typename K, typename H = std::hash<K>>
+	bool post(K const& key, task_t task) {
+		return post_(H{}(key), std::move(task));
+	}
+	///	@brief	Terminates this executor.
+	///		It stops accepting tasks, waits for the workers to execute the tasks already posted, and joins them.
+	///		If it is called from a task, it returns without waiting, and the destructor joins the workers.
+	void terminate() noexcept;
+	///	@brief	Is this executor terminated?
+	///	@return		It returns true if it has been terminated; otherwise, it returns false.
+	bool terminated() const noexcept { return finished_.load(); }
+	///	@brief	Gets the number of workers.
+	///	@return		The number of workers.
+	std::size_t size() const noexcept { return threads_.size(); }
+
+	///	@brief	Constructor.
+	///	@param[in]	threads		The number of workers, or zero to use the number of hardware threads.
+	///	@param[in]	quantum		The maximum number of tasks of a key which a worker executes at once.
+	explicit keyed_executor_t(std::size_t threads = 0u, std::size_t quantum = 64u);
+	///	@brief	Destructor.
+	///		It must not be called from a task of this executor.
+	~keyed_executor_t() noexcept;
+
+private:
+	keyed_executor_t(keyed_executor_t const&)			 = delete;
+	keyed_executor_t& operator=(keyed_executor_t const&) = delete;
+
+	///	@brief	Tasks of a key.
+	struct strand_t {
+		std::deque<task_t> tasks;	   ///< Tasks not started.
+		bool			   running;	   ///< Whether a worker is executing the tasks.
+	};
+
+	bool post_(std::size_t key, task_t task);
+	void run_() noexcept;
+
+	std::vector<std::thread>				  threads_;		///< Workers.
+	std::size_t const						  quantum_;		///< The maximum number of tasks executed at once.
+	std::mutex								  mutex_;		///< Mutex.
+	std::condition_variable					  condition_;	///< Condition for idle workers to wait.
+	std::unordered_map<std::size_t, strand_t> strands_;		///< Strands which have tasks or are running.
+	std::deque<std::size_t>					  ready_;		///< Keys of strands which have tasks and are not running.
+	std::atomic<bool>						  finished_;	///< Finished flag.
+	std::once_flag							  joined_;		///< Flag to join the workers only once.
+};
+
+}	 // namespace xxx
+
+#endif	  // xxx_KEYED_EXECUTOR_HXX_
@@ -13,15 +13,21 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <ctime>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <map>
+#include <memory>
 #include <optional>
 #include <set>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #if 201703L <= __cplusplus && __has_include(<source_location>)
@@ -73,10 +79,65 @@ is_valid_level(int level) noexcept {
 	return static_cast<int>(xxx::log::level_t::Silent) <= level && level <= static_cast<int>(xxx::log::level_t::All);
 }
 
+///	@brief	overflow policy of queued logging.
+enum class overflow_t {
+	Block,		   ///< Blocks the caller until the queue has room.
+	DropOldest,	   ///< Drops the oldest record of the least severe level; Error or more severe waits for room instead.
+	DropNewest,	   ///< Drops the newest record of the least severe level; Error or more severe waits for room instead.
+	Spill,		   ///< Spills overflow to a temporary file, which is replayed later; if the spill backlog is full, it drops records but Error or more severe waits.
+};
+
+///	@brief	escaping style of log payloads.
+enum class escape_t {
+	Text,	 ///< Plain text: quotes, back slashes, control and non-ASCII bytes are escaped.
+	Json,	 ///< JSON string: quotes, back slashes and control characters are escaped.
+};
+
 #if ! defined(xxx_no_logging)
 
 namespace impl {
 
+//	Log record.
+struct record_t {
+	level_t								  level;	   // Logging level.
+	std::chrono::system_clock::time_point time;		   // Timestamp.
+	std::tm								  lt;		   // Local time of the timestamp.
+	std::string							  tid;		   // Thread identifier.
+	std::string							  file;		   // File name of source.
+	std::uint_least32_t					  line;		   // Line of source.
+	std::string							  function;	   // Function name of source.
+	std::string							  message;	   // Log message.
+	std::string							  text;		   // Formatted log.
+};
+
+class db_sink_t;
+class async_sink_t;
+
+//	Finds the first byte which needs escaping.
+//	It scans 16 or 32 bytes at once if SSE2 or AVX2 is available.
+//	@param[in]		data	Bytes to scan.
+//	@param[in]		size	The number of the bytes.
+//	@param[in]		escape	Escaping style.
+//	@return		The offset of the first byte to escape, or the @p size if no byte needs escaping.
+std::size_t find_escape_(char const* data, std::size_t size, escape_t escape) noexcept;
+//	Escapes bytes.
+//	Clean runs between the escaped bytes are written in bulk.
+//	@param[in,out]	os		Output stream.
+//	@param[in]		text	Bytes to escape.
+//	@param[in]		escape	Escaping style.
+void escape_(std::ostream& os, std::string_view text, escape_t escape);
+
+#if defined(__cpp_char8_t) && 201803 <= __cpp_char8_t
+
+template<typename... Args>
+void dump_(std::ostream& os, char8_t head, Args... args);
+template<typename... Args>
+void dump_(std::ostream& os, std::u8string_view const& head, Args... args);
+template<typename... Args>
+void dump_(std::ostream& os, std::u8string const& head, Args... args);
+
+#endif	  // __cpp_char8_t
+
 //	Dumps arguments.
 //	@param[in,out]	os		Output stream.
 //	@param[in]		head	Head of arguments.
@@ -187,24 +248,64 @@ dump_(std::ostream& os, std::unordered_set<T> const& head, Args... args) {
 
 #if defined(__cpp_char8_t) && 201803 <= __cpp_char8_t
 
-template<typename T>
+//	Dumps UTF-8 character arguments.
+//	@param[in,out]	os		Output stream.
+//	@param[in]		head	Head of arguments.
+//	@param[in]		args	Other argument(s).
+template<typename... Args>
 inline void
-dump_(std::ostream& os, char8_t ch) {
-	if (ch < 0x80) {
-		os << static_cast<char>(ch);
-	} else {
-		os << std::hex << std::setfill('0') << std::setw(2) << std::uppercase << static_cast<unsigned>(ch);
+dump_(std::ostream& os, char8_t head, Args... args) {
+	escape_(os, std::string_view{reinterpret_cast<char const*>(&head), 1u}, escape_t::Text);
+	if constexpr (0 < sizeof...(Args)) {
+		dump_(os, args...);
 	}
 }
-
-template<typename T>
+//	Dumps UTF-8 string arguments.
+//	@param[in,out]	os		Output stream.
+//	@param[in]		head	Head of arguments.
+//	@param[in]		args	Other argument(s).
+template<typename... Args>
 inline void
-dump_(std::ostream& os, std::u8string_view const& head) {
-	std::for_each(head.cbegin(), head.cend(), [&](auto const ch) { dump_(os, ch); });
+dump_(std::ostream& os, std::u8string_view const& head, Args... args) {
+	escape_(os, std::string_view{reinterpret_cast<char const*>(head.data()), head.size()}, escape_t::Text);
+	if constexpr (0 < sizeof...(Args)) {
+		dump_(os, args...);
+	}
+}
+//	Dumps UTF-8 string arguments.
+//	@param[in,out]	os		Output stream.
+//	@param[in]		head	Head of arguments.
+//	@param[in]		args	Other argument(s).
+template<typename... Args>
+inline void
+dump_(std::ostream& os, std::u8string const& head, Args... args) {
+	dump_(os, std::u8string_view{head}, args...);
 }
 
 #endif	  // __cpp_char8_t
 
+//	Whether the type can be dumped or not.
+template<typename T>
+struct is_dumpable_ : std::bool_constant<requires(std::ostream& os, T const& t) { os << t; }> {};
+template<typename T>
+struct is_dumpable_<std::vector<T>> : is_dumpable_<T> {};
+template<typename T, typename V>
+struct is_dumpable_<std::map<T, V>> : std::conjunction<is_dumpable_<T>, is_dumpable_<V>> {};
+template<typename T>
+struct is_dumpable_<std::set<T>> : is_dumpable_<T> {};
+template<typename T, typename V>
+struct is_dumpable_<std::unordered_map<T, V>> : std::conjunction<is_dumpable_<T>, is_dumpable_<V>> {};
+template<typename T>
+struct is_dumpable_<std::unordered_set<T>> : is_dumpable_<T> {};
+#if defined(__cpp_char8_t) && 201803 <= __cpp_char8_t
+template<>
+struct is_dumpable_<char8_t> : std::true_type {};
+template<>
+struct is_dumpable_<std::u8string_view> : std::true_type {};
+template<>
+struct is_dumpable_<std::u8string> : std::true_type {};
+#endif	  // __cpp_char8_t
+
 //	Dumps arguments with separation comma.
 //	@param[in,out]	os		Output stream.
 //	@param[in]		head	Head of arguments.
@@ -261,6 +362,110 @@ cat([[maybe_unused]] Args... args) {
 #endif	  // xxx_no_logging
 }
 
+///	@brief	Escapes text for a log payload.
+///	@param[in]		text		Text to escape.
+///	@param[in]		escape		Escaping style.
+///	@return		Escaped text.
+inline std::string
+escape([[maybe_unused]] std::string_view const text, [[maybe_unused]] escape_t escape = escape_t::Text) {
+#if ! defined(xxx_no_logging)
+	std::ostringstream oss;
+	impl::escape_(oss, text, escape);
+	return oss.str();
+#else	  // xxx_no_logging
+	return std::string();
+#endif	  // xxx_no_logging
+}
+
+///	@brief	Format string checked at compile time.
+///	@details	Each "{}" placeholder is replaced with the corresponding argument in order,
+///				and "{{" and "}}" mean literal braces.
+///				The number of the placeholders and the types of the arguments are checked at compile time,
+///				and the format is split into literal segments in advance.
+///	@tparam			Args		Arguments.
+template<typename... Args>
+class basic_format_t {
+public:
+	///	@brief	Parses format string at compile time.
+	///	@param[in]		format		Format string.
+	///	@param[in]		pos			Position of source.
+	template<std::size_t N>
+	consteval basic_format_t(char const (&format)[N], std::source_location const& pos = std::source_location::current()) :
+		format_{format, N - 1}, segments_{}, pos_{pos} {
+		std::size_t n{}, begin{};
+		bool		escaped{};
+		for (std::size_t i{}; i < format_.size(); ++i) {
+			auto const next = i + 1 < format_.size() ? format_[i + 1] : '\0';
+			if (format_[i] == '{' && next == '{') {
+				escaped = true;
+				++i;
+			} else if (format_[i] == '{' && next == '}') {
+				if (sizeof...(Args) <= n) throw std::invalid_argument("too many placeholders");
+				segments_[n++] = segment_t{begin, i - begin, escaped};
+				begin		   = i + 2;
+				escaped		   = false;
+				++i;
+			} else if (format_[i] == '}' && next == '}') {
+				escaped = true;
+				++i;
+			} else if (format_[i] == '{' || format_[i] == '}') {
+				throw std::invalid_argument("unmatched brace");
+			}
+		}
+		if (n != sizeof...(Args)) throw std::invalid_argument("too few placeholders");
+		segments_[n] = segment_t{begin, format_.size() - begin, escaped};
+	}
+
+	///	@brief	Gets the position of source.
+	///	@return		Position of source.
+	auto const& pos() const noexcept { return pos_; }
+
+#if ! defined(xxx_no_logging)
+	static_assert((impl::is_dumpable_<Args>::value && ...), "unsupported type of argument");
+
+	///	@brief	Formats arguments.
+	///	@param[in,out]	os		Output stream.
+	///	@param[in]		args	Arguments.
+	void format(std::ostream& os, Args const&... args) const {
+		std::size_t i{};
+		((write_(os, segments_[i++]), impl::dump_(os, args)), ...);
+		write_(os, segments_[i]);
+	}
+#endif	  // xxx_no_logging
+
+private:
+	///	@brief	Literal segment of the format string.
+	struct segment_t {
+		std::size_t offset;		///< Offset in the format string.
+		std::size_t size;		///< Size of the segment.
+		bool		escaped;	///< Whether the segment contains doubled braces or not.
+	};
+
+#if ! defined(xxx_no_logging)
+	void write_(std::ostream& os, segment_t const& segment) const {
+		auto const literal = format_.substr(segment.offset, segment.size);
+		if (! segment.escaped) {
+			os.write(literal.data(), static_cast<std::streamsize>(literal.size()));
+			return;
+		}
+		for (std::size_t i{}; i < literal.size(); ++i) {
+			os.put(literal[i]);
+			if (literal[i] == '{' || literal[i] == '}') ++i;
+		}
+	}
+#endif	  // xxx_no_logging
+
+private:
+	std::string_view						  format_;	   ///< Format string.
+	std::array<segment_t, sizeof...(Args) + 1> segments_;	 ///< Literal segments.
+	std::source_location					  pos_;		   ///< Position of source.
+};
+
+///	@brief	Format string checked at compile time.
+///	@tparam			Args		Arguments, which are not deduced from the format string.
+template<typename... Args>
+using format_t = basic_format_t<std::type_identity_t<Args>...>;
+
 #if defined(xxx_no_logging)
 
 class logger_t {
@@ -275,10 +480,33 @@ public:
 	void trace(std::string_view const, std::source_location const& pos = std::source_location::current()) {}
 	void verbose(std::string_view const, std::source_location const& pos = std::source_location::current()) {}
 
+	template<typename... Args>
+	void logf(level_t, format_t<Args...> const&, Args const&...) {}
+	template<typename... Args>
+	void oopsf(format_t<Args...> const&, Args const&...) {}
+	template<typename... Args>
+	void errf(format_t<Args...> const&, Args const&...) {}
+	template<typename... Args>
+	void warnf(format_t<Args...> const&, Args const&...) {}
+	template<typename... Args>
+	void noticef(format_t<Args...> const&, Args const&...) {}
+	template<typename... Args>
+	void infof(format_t<Args...> const&, Args const&...) {}
+	template<typename... Args>
+	void debugf(format_t<Args...> const&, Args const&...) {}
+	template<typename... Args>
+	void tracef(format_t<Args...> const&, Args const&...) {}
+	template<typename... Args>
+	void verbosef(format_t<Args...> const&, Args const&...) {}
+
 public:
 	void set_logger(std::string_view const) {}
 	void set_path(std::filesystem::path const) {}
 	void set_console(bool) {}
+	void set_repeat_suppression(bool, std::chrono::milliseconds = std::chrono::seconds{30}) {}
+	void set_database(std::filesystem::path const&, std::string_view const = "log", std::size_t = 65536u) {}
+	void set_queue(std::size_t, overflow_t = overflow_t::Block) {}
+	void set_index_interval(std::size_t) {}
 
 	auto logger() const noexcept { return std::filesystem::path(); }
 	auto path() const noexcept { return std::string(); }
@@ -358,6 +586,88 @@ public:
 	verbose(std::string_view const message, std::source_location const& pos = std::source_location::current()) {
 		log_(level_t::Verbose, pos, message);
 	}
+	///	@brief	Dumps formatted log.
+	///	@tparam			Args		Arguments.
+	///	@param[in]		level		Logging level.
+	///	@param[in]		format		Format string checked at compile time.
+	///	@param[in]		args		Arguments to replace the placeholders.
+	template<typename... Args>
+	void
+	logf(level_t level, format_t<Args...> const& format, Args const&... args) {
+		logf_(level, format, args...);
+	}
+	///	@brief	Dumps formatted log as fatal error.
+	///	@tparam			Args		Arguments.
+	///	@param[in]		format		Format string checked at compile time.
+	///	@param[in]		args		Arguments to replace the placeholders.
+	template<typename... Args>
+	void
+	oopsf(format_t<Args...> const& format, Args const&... args) {
+		logf_(level_t::Fatal, format, args...);
+	}
+	///	@brief	Dumps formatted log as normal error.
+	///	@tparam			Args		Arguments.
+	///	@param[in]		format		Format string checked at compile time.
+	///	@param[in]		args		Arguments to replace the placeholders.
+	template<typename... Args>
+	void
+	errf(format_t<Args...> const& format, Args const&... args) {
+		logf_(level_t::Error, format, args...);
+	}
+	///	@brief	Dumps formatted log as warning.
+	///	@tparam			Args		Arguments.
+	///	@param[in]		format		Format string checked at compile time.
+	///	@param[in]		args		Arguments to replace the placeholders.
+	template<typename... Args>
+	void
+	warnf(format_t<Args...> const& format, Args const&... args) {
+		logf_(level_t::Warn, format, args...);
+	}
+	///	@brief	Dumps formatted log as notice.
+	///	@tparam			Args		Arguments.
+	///	@param[in]		format		Format string checked at compile time.
+	///	@param[in]		args		Arguments to replace the placeholders.
+	template<typename... Args>
+	void
+	noticef(format_t<Args...> const& format, Args const&... args) {
+		logf_(level_t::Notice, format, args...);
+	}
+	///	@brief	Dumps formatted log as information.
+	///	@tparam			Args		Arguments.
+	///	@param[in]		format		Format string checked at compile time.
+	///	@param[in]		args		Arguments to replace the placeholders.
+	template<typename... Args>
+	void
+	infof(format_t<Args...> const& format, Args const&... args) {
+		logf_(level_t::Info, format, args...);
+	}
+	///	@brief	Dumps formatted log as debug info.
+	///	@tparam			Args		Arguments.
+	///	@param[in]		format		Format string checked at compile time.
+	///	@param[in]		args		Arguments to replace the placeholders.
+	template<typename... Args>
+	void
+	debugf(format_t<Args...> const& format, Args const&... args) {
+		logf_(level_t::Debug, format, args...);
+	}
+	///	@brief	Dumps formatted log as trace.
+	///	@tparam			Args		Arguments.
+	///	@param[in]		format		Format string checked at compile time.
+	///	@param[in]		args		Arguments to replace the placeholders.
+	template<typename... Args>
+	void
+	tracef(format_t<Args...> const& format, Args const&... args) {
+		logf_(level_t::Trace, format, args...);
+	}
+	///	@brief	Dumps formatted log as verbose.
+	///	@tparam			Args		Arguments.
+	///	@param[in]		format		Format string checked at compile time.
+	///	@param[in]		args		Arguments to replace the placeholders.
+	template<typename... Args>
+	void
+	verbosef(format_t<Args...> const& format, Args const&... args) {
+		logf_(level_t::Verbose, format, args...);
+	}
 
 public:
 	///	@brief	Sets the external logger name as the following:
@@ -378,6 +688,38 @@ public:
 	///	@brief	Sets logging level.
 	///	@param[in]		level		Logger level.
 	void set_level(level_t level) { level_ = level; }
+	///	@brief	Sets whether consecutive duplicated logs are collapsed or not.
+	///		A duplicated log has the same message, level and source position as the previous one.
+	///		Duplicates are counted instead of being formatted and written,
+	///		and a "last message repeated N times" log is dumped when the run ends or the @p timeout elapses.
+	///	@param[in]		on			Whether duplicated logs are collapsed or not.
+	///	@param[in]		timeout		Period to dump the count even if the duplicates continue.
+	void set_repeat_suppression(bool on, std::chrono::milliseconds timeout = std::chrono::seconds{30});
+	///	@brief	Sets SQLite database to store logs.
+	///		Logs are stored to the @p table, which has the following columns:
+	///		timestamp (microseconds since the epoch), level, tid, file, line, function and message.
+	///		A background thread inserts them in batches so that logging does not wait for the database.
+	///		When the @p capacity records are waiting, new records are dropped and reported as a warning row,
+	///		but Error or more severe records wait for room instead.
+	///	@param[in]		path		The path of database, or empty to stop storing logs.
+	///	@param[in]		table		Table name.
+	///	@param[in]		capacity	The number of records to wait for the database.
+	void set_database(std::filesystem::path const& path, std::string_view const table = "log", std::size_t capacity = 65536u);
+	///	@brief	Sets queued logging up.
+	///		Records are formatted by the caller and written to the sinks by a background thread,
+	///		and the @p overflow policy decides what happens when the writer falls behind.
+	///		Dropped records are counted and reported as a warning.
+	///	@param[in]		capacity	The number of records to queue, or zero to write them synchronously.
+	///	@param[in]		overflow	Overflow policy.
+	void set_queue(std::size_t capacity, overflow_t overflow = overflow_t::Block);
+	///	@brief	Sets the interval of the time index of the log file.
+	///		The index is stored beside the log file with ".idx" suffix,
+	///		and has the byte offset of a record at every @p interval bytes at least,
+	///		with the latest timestamp of the records up to it.
+	///		An index which does not match the log file, such as the one left for a log recreated by others, is rebuilt.
+	///		See read_logs() to read logs in a time range with the index.
+	///	@param[in]		interval	Interval in bytes, or zero to stop indexing.
+	void set_index_interval(std::size_t interval);
 
 	///	@brief	Gets the external logger name.
 	///	@return		External logger name.
@@ -391,6 +733,20 @@ public:
 	auto console() const noexcept { return console_; }
 	///	@brief	Gets whether log file is daily or not.
 	auto is_logfile_daily() const noexcept { return daily_; }
+	///	@brief	Gets whether consecutive duplicated logs are collapsed or not.
+	auto repeat_suppression() const noexcept { return suppressing_.load(std::memory_order_relaxed); }
+	///	@brief	Gets the path of database to store logs.
+	///	@return		The path of database.
+	auto const& database() const noexcept { return database_; }
+	///	@brief	Gets the capacity of queued logging.
+	///	@return		The number of records to queue, or zero if records are written synchronously.
+	auto queue_capacity() const noexcept { return queue_capacity_; }
+	///	@brief	Gets the overflow policy of queued logging.
+	///	@return		Overflow policy.
+	auto overflow() const noexcept { return overflow_; }
+	///	@brief	Gets the interval of the time index of the log file.
+	///	@return		Interval in bytes, or zero if the log file is not indexed.
+	auto index_interval() const noexcept { return index_interval_; }
 
 public:
 	///	@brief	Constructor.
@@ -402,12 +758,64 @@ public:
 	logger_t(level_t level, std::filesystem::path const& path, std::string_view const logger, bool console, bool daily = false);
 	///	@brief	Constructor.
 	logger_t() :
-		level_{level_t::Info}, path_{}, logger_{}, console_{true}, daily_{}, ofs_{}, mutex_{}, file_mutex_{}, console_mutex_{} {}
+		level_{level_t::Info}, path_{}, logger_{}, console_{true}, daily_{}, ofs_{}, repeat_timeout_{}, repeat_{}, suppressing_{}, database_{}, db_{}, queue_capacity_{}, overflow_{}, async_{}, index_interval_{}, idx_ofs_{}, offset_{}, indexed_{}, latest_{}, mutex_{}, file_mutex_{}, console_mutex_{}, repeat_mutex_{}, db_mutex_{}, async_mutex_{}, sink_mutex_{} {}
+	///	@brief	Destructor.
+	///		It dumps the count of suppressed duplicates if any, and writes the queued records.
+	~logger_t();
 
 private:
+	///	@brief	Run of duplicated logs.
+	struct repeat_t {
+		std::size_t							  hash;		///< Hash of the message.
+		std::string							  message;	///< Message, which is compared if the hashes are the same.
+		level_t								  level;	///< Logging level.
+		std::optional<std::source_location>	  pos;		///< Position of source.
+		std::size_t							  count;	///< The number of suppressed duplicates.
+		std::chrono::steady_clock::time_point since;	///< Beginning of the current period.
+	};
+
 	void log_(level_t level, std::optional<std::source_location> const& pos, std::string_view const message);
+	template<typename... Args>
+	void logf_(level_t level, format_t<Args...> const& format, Args const&... args) {
+		// Filtered logs do not render any argument.
+		if (static_cast<int>(level_) < static_cast<int>(level)) {
+			expire_repeat_();
+			return;
+		}
+
+		std::ostringstream oss;
+		format.format(oss, args...);
+		log_(level, format.pos(), oss.str());
+	}
+	bool suppress_repeat_(level_t level, std::optional<std::source_location> const& pos, std::string_view const message);
+	void expire_repeat_();
+	void flush_repeat_();
+	void dump_repeat_(std::optional<repeat_t> const& repeat);
+	// Gets a sink under the lock.
+	template<typename S>
+	std::shared_ptr<S> load_sink_(std::shared_ptr<S> const& sink) const {
+		std::lock_guard lock{sink_mutex_};
+		return sink;
+	}
+	// Replaces a sink under the lock, and destroys the previous one after the lock,
+	// because it might write the records left through the other sinks.
+	template<typename S>
+	void exchange_sink_(std::shared_ptr<S>& sink, std::type_identity_t<std::shared_ptr<S>> next) {
+		{
+			std::lock_guard lock{sink_mutex_};
+			sink.swap(next);
+		}
+		next.reset();
+	}
+	void output_(level_t level, std::optional<std::source_location> const& pos, std::string_view const message);
+	impl::record_t make_dropped_(std::size_t drops) const;
+	impl::record_t make_record_(level_t level, std::optional<std::source_location> const& pos, std::string_view const message) const;
+	void		   write_(impl::record_t const& record);
 	void get_local_now_(std::chrono::system_clock::time_point const& now, std::tm& tm) const;
 	void open_logfile_(std::filesystem::path const& path, std::optional<std::tm> const& lt);
+	void close_logfile_();
+	void rotate_logfile_();
+	void open_index_();
 	bool needs_rotation(std::tm const& lt) const {
 		return daily_ && (daily_->tm_year != lt.tm_year || daily_->tm_yday != lt.tm_yday) && std::filesystem::exists(path_);
 	}
@@ -420,9 +828,26 @@ private:
 	bool				   console_;		  ///< Whether dump it to standard error or not.
 	std::optional<std::tm> daily_;			  ///< Whether log file is daily or not.
 	std::ofstream		   ofs_;			  ///< Output file stream.
+	std::optional<std::chrono::milliseconds> repeat_timeout_;	///< Period to dump suppressed duplicates, or nullopt if not suppressed.
+	std::optional<repeat_t>					 repeat_;			///< Current run of duplicated logs.
+	std::atomic<bool>						 suppressing_;		///< Whether duplicated logs are collapsed, which is read without the lock.
+	std::filesystem::path					 database_;			///< The path of database.
+	std::shared_ptr<impl::db_sink_t>		 db_;				///< Database sink.
+	std::size_t								 queue_capacity_;	///< Capacity of queued logging.
+	overflow_t								 overflow_;			///< Overflow policy of queued logging.
+	std::shared_ptr<impl::async_sink_t>		 async_;			///< Queued logging.
+	std::size_t								 index_interval_;	///< Interval of the time index in bytes.
+	std::ofstream							 idx_ofs_;			///< Output file stream of the time index.
+	std::uint64_t							 offset_;			///< Size of the log file.
+	std::optional<std::uint64_t>			 indexed_;			///< Offset of the last indexed record.
+	std::int64_t							 latest_;			///< The latest timestamp written to the log file in microseconds.
 	mutable std::mutex	   mutex_;			  ///< Mutex.
 	mutable std::mutex	   file_mutex_;		  ///< Mutex.
 	mutable std::mutex	   console_mutex_;	  ///< Mutex.
+	mutable std::mutex	   repeat_mutex_;	  ///< Mutex.
+	mutable std::mutex	   db_mutex_;		  ///< Mutex.
+	mutable std::mutex	   async_mutex_;	  ///< Mutex.
+	mutable std::mutex	   sink_mutex_;		  ///< Mutex of the pointers to the sinks.
 };
 
 #endif	  // xxx_no_logging
@@ -450,6 +875,27 @@ void remove_logger(std::string const& tag);
 ///	@return			Logger.
 logger_t& logger(std::string const& tag);
 
+///	@brief	Parses the timestamp at the head of a log.
+///	@param[in]		text		Text beginning with a timestamp such as "2018-01-23T01:23:45.678901+0900".
+///								The fraction and the time zone are optional, and local time is assumed without the zone.
+///	@return			The timestamp, or nullopt if the @p text does not begin with a timestamp.
+std::optional<std::chrono::system_clock::time_point> parse_timestamp(std::string_view const text);
+///	@brief	Finds the offset of the log file to read logs since the time.
+///		It uses the time index beside the log file if exists; see logger_t::set_index_interval().
+///	@param[in]		path		The path of log file.
+///	@param[in]		from		The time to read logs since.
+///	@return			The offset of a log at @p from or before, or zero if unknown.
+std::uint64_t find_log_offset(std::filesystem::path const& path, std::chrono::system_clock::time_point const& from);
+///	@brief	Reads logs in the time range.
+///		It seeks straight to the range with the time index beside the log file if exists.
+///		Records written out of order are read up to the index entry after the range, or to the end of the file without the index.
+///		Lines without timestamp belong to the previous log.
+///	@param[in]		path		The path of log file.
+///	@param[in]		from		Beginning of the range (inclusive).
+///	@param[in]		to			End of the range (exclusive).
+///	@param[in]		reader		Function called with each line in the range.
+void read_logs(std::filesystem::path const& path, std::chrono::system_clock::time_point const& from, std::chrono::system_clock::time_point const& to, std::function<void(std::string_view const)> const& reader);
+
 #endif	  // xxx_no_logging
 
 #if defined(xxx_no_logging)
@@ -0,0 +1,236 @@
+///	@file
+///	@brief		xxx common library.
+///	@details	Bounded lock-free queue for multiple producers and multiple consumers.
+///	@pre		ISO/IEC 14882:2020 or higher
+///	@author		Mura
+///	@copyright	(C) 2023-, Mura. All rights reserved. (MIT License)
+
+#ifndef xxx_MPMC_QUEUE_HXX_
+#define xxx_MPMC_QUEUE_HXX_
+
+#include <xxx/queue.hxx>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace xxx {
+
+///	@brief	Bounded event queue for multiple producers and multiple consumers.
+///		It is a ring buffer, each slot of which has a sequence number to tell producers and consumers its turn,
+///		so that any operation takes no lock as long as the queue is neither empty nor full.
+///		The enqueue(), dequeue() and terminate() behave the same as the xxx::queue
+///		except that the enqueue() waits while the queue is full.
+template<typename T>
+class mpmc_queue {
+	static_assert(std::is_nothrow_move_constructible_v<T> && std::is_nothrow_destructible_v<T>);
+
+public:
+	/// @brief 	Enqueues an event.
+	///		If this queue is full, this method waits a room.
+	/// @param[in]	t	The event to push.
+	/// @return	It returns true if queued; otherwise, it returns false.
+	bool enqueue(T const& t) { return push_(t); }
+	/// @brief 	Enqueues an event.
+	///		If this queue is full, this method waits a room.
+	/// @param[in]	t	The event to push.
+	/// @return	It returns true if queued; otherwise, it returns false.
+	bool enqueue(T&& t) { return push_(std::move(t)); }
+	/// @brief 	Enqueues an event if this queue is not full.
+	/// @param[in]	t	The event to push.
+	/// @return	It returns true if queued; otherwise, it returns false.
+	bool try_enqueue(T const& t) { return try_push_(t); }
+	/// @brief 	Enqueues an event if this queue is not full.
+	/// @param[in]	t	The event to push.
+	/// @return	It returns true if queued; otherwise, it returns false.
+	bool try_enqueue(T&& t) { return try_push_(std::move(t)); }
+	/// @brief 	Dequeues an event.
+	///		If this queue is empty, this method waits a new event.
+	/// @param[in]	t	Next event.
+	/// @return	It returns true if dequeued; otherwise, it returns false.
+	bool dequeue(T& t) {
+		for (;;) {
+			if (terminated()) return false;
+			if (try_dequeue(t)) return true;
+
+			// Registers as a waiter before checking the queue again,
+			// so that a producer surely sees the waiter or this consumer surely sees the event.
+			auto const epoch = not_empty_.load();
+			consumers_.fetch_add(1u);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (empty() && ! terminated()) {
+				not_empty_.wait(epoch);
+			}
+			consumers_.fetch_sub(1u);
+		}
+	}
+	/// @brief 	Dequeues an event if this queue is not empty.
+	/// @param[in]	t	Next event.
+	/// @return	It returns true if dequeued; otherwise, it returns false.
+	bool try_dequeue(T& t) {
+		return pop_([&t](T&& e) { t = std::move(e); });	   // might cause an exception.
+	}
+	/// @brief 	Terminates this queue.
+	///		Waiting producers and consumers return false, and the events left are discarded.
+	void terminate() noexcept {
+		finished_.store(true);
+		wake_(not_empty_);
+		wake_(not_full_);
+		while (pop_([](T&&) {})) {}
+	}
+	/// @brief 	Is this queue empty?
+	/// @return		It returns true if the queue is empty; otherwise, it returns false.
+	bool empty() const noexcept { return size() == 0u; }
+	/// @brief 	Gets the number of events.
+	///		It is just a snapshot while other threads are enqueuing or dequeuing events.
+	/// @return		The number of events.
+	std::size_t size() const noexcept {
+		auto const tail = tail_.load(std::memory_order_acquire);
+		auto const head = head_.load(std::memory_order_acquire);
+		return head <= tail ? 0u : std::min(head - tail, capacity());
+	}
+	/// @brief 	Gets the capacity.
+	/// @return		The maximum number of events.
+	std::size_t capacity() const noexcept { return mask_ + 1u; }
+	/// @brief 	Is this queue terminated?
+	/// @return		It returns true if the queue has been terminated; otherwise, it returns false.
+	bool terminated() const noexcept { return finished_.load(); }
+
+	/// @brief 	Constructor.
+	/// @param[in]	capacity	The maximum number of events, which is rounded up to a power of two.
+	explicit mpmc_queue(std::size_t capacity) :
+		mask_{std::bit_ceil(std::max(capacity, std::size_t{2u})) - 1u}, slots_{std::make_unique<slot_t[]>(mask_ + 1u)}, head_{}, tail_{}, not_empty_{}, not_full_{}, consumers_{}, producers_{}, finished_{} {
+		for (std::size_t i{}; i <= mask_; ++i) {
+			slots_[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+	/// @brief 	Destructor.
+	~mpmc_queue() noexcept { terminate(); }
+
+private:
+	mpmc_queue(mpmc_queue const&)			 = delete;
+	mpmc_queue& operator=(mpmc_queue const&) = delete;
+
+	///	@brief	Slot of the ring buffer.
+	struct slot_t {
+		std::atomic<std::size_t> sequence;					///< Turn of this slot; the position to enqueue, or the position + 1 to dequeue.
+		alignas(T) std::byte	 storage[sizeof(T)];		///< Storage of an event.
+
+		T* get() noexcept { return std::launder(reinterpret_cast<T*>(storage)); }
+	};
+
+	template<typename U>
+	bool push_(U&& u) {
+		if constexpr (! std::is_nothrow_constructible_v<T, U&&>) {
+			// Copies the event in advance not to fail after claiming a slot.
+			T t(std::forward<U>(u));
+			return push_(std::move(t));
+		} else {
+			for (;;) {
+				if (terminated()) return false;
+				if (try_push_(std::forward<U>(u))) return true;
+
+				auto const epoch = not_full_.load();
+				producers_.fetch_add(1u);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				if (capacity() <= size() && ! terminated()) {
+					not_full_.wait(epoch);
+				}
+				producers_.fetch_sub(1u);
+			}
+		}
+	}
+	template<typename U>
+	bool try_push_(U&& u) {
+		if constexpr (! std::is_nothrow_constructible_v<T, U&&>) {
+			// Copies the event in advance not to fail after claiming a slot.
+			T t(std::forward<U>(u));
+			return try_push_(std::move(t));
+		} else {
+			if (terminated()) return false;
+
+			auto pos = head_.load(std::memory_order_relaxed);
+			for (;;) {
+				auto&	   slot = slots_[pos & mask_];
+				auto const seq	= slot.sequence.load(std::memory_order_acquire);
+				auto const diff = static_cast<std::ptrdiff_t>(seq - pos);
+				if (diff == 0) {
+					// This slot is empty; claims it.
+					if (head_.compare_exchange_weak(pos, pos + 1u, std::memory_order_relaxed)) {
+						::new (static_cast<void*>(slot.storage)) T(std::forward<U>(u));
+						slot.sequence.store(pos + 1u, std::memory_order_release);
+						notify_(not_empty_, consumers_);
+						return true;
+					}
+				} else if (diff < 0) {
+					return false;	 // full
+				} else {
+					pos = head_.load(std::memory_order_relaxed);
+				}
+			}
+		}
+	}
+	template<typename F>
+	bool pop_(F&& f) {
+		auto pos = tail_.load(std::memory_order_relaxed);
+		for (;;) {
+			auto&	   slot = slots_[pos & mask_];
+			auto const seq	= slot.sequence.load(std::memory_order_acquire);
+			auto const diff = static_cast<std::ptrdiff_t>(seq - (pos + 1u));
+			if (diff == 0) {
+				// This slot has an event; claims it.
+				if (tail_.compare_exchange_weak(pos, pos + 1u, std::memory_order_relaxed)) {
+					{
+						// Releases the slot even if the f throws an exception.
+						struct release_t {
+							slot_t&		slot;
+							std::size_t next;
+							~release_t() {
+								slot.get()->~T();
+								slot.sequence.store(next, std::memory_order_release);
+							}
+						} const release{slot, pos + mask_ + 1u};
+						f(std::move(*slot.get()));
+					}
+					notify_(not_full_, producers_);
+					return true;
+				}
+			} else if (diff < 0) {
+				return false;	 // empty
+			} else {
+				pos = tail_.load(std::memory_order_relaxed);
+			}
+		}
+	}
+	static void notify_(std::atomic<std::uint32_t>& epoch, std::atomic<std::uint32_t> const& waiters) noexcept {
+		// Pairs with the fence of the waiter.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (0u < waiters.load(std::memory_order_relaxed)) {
+			wake_(epoch);
+		}
+	}
+	static void wake_(std::atomic<std::uint32_t>& epoch) noexcept {
+		epoch.fetch_add(1u);
+		epoch.notify_all();
+	}
+
+	std::size_t const								  mask_;		 ///< Capacity - 1.
+	std::unique_ptr<slot_t[]>						  slots_;		 ///< Ring buffer.
+	alignas(cache_line_size) std::atomic<std::size_t> head_;		 ///< Position to enqueue.
+	alignas(cache_line_size) std::atomic<std::size_t> tail_;		 ///< Position to dequeue.
+	alignas(cache_line_size) std::atomic<std::uint32_t> not_empty_;	 ///< Epoch to wait a new event.
+	std::atomic<std::uint32_t>						  not_full_;	 ///< Epoch to wait a room.
+	std::atomic<std::uint32_t>						  consumers_;	 ///< The number of waiting consumers.
+	std::atomic<std::uint32_t>						  producers_;	 ///< The number of waiting producers.
+	std::atomic<bool>								  finished_;	 ///< Finished flag.
+};
+
+}	 // namespace xxx
+
+#endif	  // xxx_MPMC_QUEUE_HXX_
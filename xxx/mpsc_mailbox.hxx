@@ -0,0 +1,145 @@
+///	@file
+///	@brief		xxx common library.
+///	@details	Intrusive lock-free queue for multiple producers and a single consumer.
+///	@pre		ISO/IEC 14882:2020 or higher
+///	@author		Mura
+///	@copyright	(C) 2023-, Mura. All rights reserved. (MIT License)
+
+#ifndef xxx_MPSC_MAILBOX_HXX_
+#define xxx_MPSC_MAILBOX_HXX_
+
+#include <xxx/queue.hxx>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <type_traits>
+
+namespace xxx {
+
+///	@brief	Node embedded in a message of the mpsc_mailbox.
+struct mpsc_node_t {
+	std::atomic<mpsc_node_t*> next{nullptr};	///< Next node.
+};
+
+///	@brief	Intrusive event queue for multiple producers and a single consumer, which is known as Vyukov's one.
+///		Messages derive from the mpsc_node_t, and they are linked in the queue without any allocation.
+///		A producer enqueues a message with a single atomic exchange, and the consumer dequeues it without any lock.
+///		The queue does not own the messages; the consumer takes over a message dequeued.
+///		The enqueue() and dequeue() behave the same as the xxx::queue,
+///		but the terminate() leaves the messages in the queue, and the consumer can still take them by try_dequeue() to reclaim them.
+///	@tparam		T	Type of message.
+template<typename T>
+class mpsc_mailbox {
+	static_assert(std::is_base_of_v<mpsc_node_t, T>);
+
+public:
+	/// @brief 	Enqueues a message.
+	/// @param[in]	t	The message to push, which has to live until it is dequeued.
+	/// @return	It returns true if queued; otherwise, it returns false.
+	bool enqueue(T* t) noexcept {
+		if (terminated()) return false;
+		push_(t);
+
+		// Pairs with the consumer, which marks itself waiting before checking the queue.
+		if (waiting_.load()) {
+			signal_.fetch_add(1u);
+			signal_.notify_one();
+		}
+		return true;
+	}
+	/// @brief 	Dequeues a message.
+	///		If this queue is empty, this method waits a new message.
+	///		Only the consumer can call it.
+	/// @param[out]	t	Next message.
+	/// @return	It returns true if dequeued; otherwise, it returns false.
+	bool dequeue(T*& t) noexcept {
+		for (std::size_t i{};; ++i) {
+			if (terminated()) return false;
+			if (try_dequeue(t)) return true;
+			if (! empty()) {
+				// A producer has exchanged the head, but has not linked its message yet.
+				i < spins ? impl::pause() : std::this_thread::yield();
+				continue;
+			}
+
+			auto const signal = signal_.load();
+			waiting_.store(true);
+			if (empty() && ! terminated()) {
+				signal_.wait(signal);
+			}
+			waiting_.store(false);
+		}
+	}
+	/// @brief 	Dequeues a message if this queue is not empty.
+	///		Only the consumer can call it, even after this queue is terminated.
+	/// @param[out]	t	Next message.
+	/// @return	It returns true if dequeued; otherwise, it returns false.
+	bool try_dequeue(T*& t) noexcept {
+		auto* tail = tail_;
+		auto* next = tail->next.load(std::memory_order_acquire);
+		if (tail == &stub_) {
+			if (! next) return false;	 // empty
+			tail_ = tail = next;
+			next		 = next->next.load(std::memory_order_acquire);
+		}
+		if (! next) {
+			// The tail is the last message, which cannot be dequeued until another node follows it.
+			if (tail != head_.load()) return false;	   // a producer is linking a message.
+			push_(&stub_);
+			next = tail->next.load(std::memory_order_acquire);
+			if (! next) return false;	 // a producer is linking a message before the stub.
+		}
+		tail_ = next;
+		t	  = static_cast<T*>(tail);
+		return true;
+	}
+	/// @brief 	Terminates this queue.
+	///		The waiting consumer returns false, and the messages left are kept for try_dequeue().
+	void terminate() noexcept {
+		finished_.store(true);
+		signal_.fetch_add(1u);
+		signal_.notify_one();
+	}
+	/// @brief 	Is this queue empty?
+	///		Only the consumer can call it.
+	/// @return		It returns true if the queue is empty; otherwise, it returns false.
+	bool empty() const noexcept {
+		// The tail is the stub unless a message is left.
+		return tail_ == &stub_ && head_.load() == &stub_;
+	}
+	/// @brief 	Is this queue terminated?
+	/// @return		It returns true if the queue has been terminated; otherwise, it returns false.
+	bool terminated() const noexcept { return finished_.load(); }
+
+	/// @brief 	Constructor.
+	mpsc_mailbox() :
+		head_{&stub_}, waiting_{}, signal_{}, finished_{}, tail_{&stub_}, stub_{} {}
+	/// @brief 	Destructor.
+	~mpsc_mailbox() noexcept { terminate(); }
+
+private:
+	mpsc_mailbox(mpsc_mailbox const&)			 = delete;
+	mpsc_mailbox& operator=(mpsc_mailbox const&) = delete;
+
+	static constexpr std::size_t spins = 64u;	 ///< The number of spins before yielding to a producer linking a message.
+
+	// Links a node after the head.
+	void push_(mpsc_node_t* node) noexcept {
+		node->next.store(nullptr, std::memory_order_relaxed);
+		auto* const prev = head_.exchange(node);
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	alignas(cache_line_size) std::atomic<mpsc_node_t*> head_;		///< Last node, which producers exchange.
+	std::atomic<bool>								   waiting_;	///< Whether the consumer is waiting.
+	std::atomic<std::uint32_t>						   signal_;		///< Epoch for the consumer to wait.
+	std::atomic<bool>								   finished_;	///< Finished flag.
+	alignas(cache_line_size) mpsc_node_t* tail_;					///< First node, which only the consumer reads.
+	mpsc_node_t stub_;												///< Node to keep the queue non-empty.
+};
+
+}	 // namespace xxx
+
+#endif	  // xxx_MPSC_MAILBOX_HXX_
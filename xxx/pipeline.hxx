@@ -0,0 +1,478 @@
+///	@file
+///	@brief		xxx common library.
+///	@details	Pipeline of stages connected by bounded queues.
+///	@pre		ISO/IEC 14882:2020 or higher
+///	@author		Mura
+///	@copyright	(C) 2023-, Mura. All rights reserved. (MIT License)
+
+#ifndef xxx_PIPELINE_HXX_
+#define xxx_PIPELINE_HXX_
+
+#include <xxx/exceptions.hxx>
+#include <xxx/mpmc_queue.hxx>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace xxx {
+
+///	@brief	Options of a stage.
+struct stage_options_t {
+	std::size_t workers{1u};	///< The number of worker threads.
+	std::size_t batch{1u};		///< The maximum number of items a worker takes at once.
+	bool		ordered{};		///< Whether the stage outputs items in the order of the input of the pipeline.
+};
+
+///	@brief	Statistics of a stage.
+struct stage_statistics_t {
+	std::size_t							workers;	  ///< The number of worker threads.
+	std::size_t							backlog;	  ///< The number of items waiting for the stage.
+	std::uint64_t						processed;	  ///< The number of items processed.
+	std::uint64_t						failed;		  ///< The number of items which the stage threw an exception for.
+	std::chrono::steady_clock::duration busy;		  ///< Total time the workers spent processing items.
+};
+
+namespace impl {
+
+///	@brief	Item flowing through a pipeline.
+template<typename T>
+struct packet_t {
+	std::uint64_t	 sequence;	  ///< Sequence number in the order of the input.
+	std::optional<T> value;		  ///< Item, or nullopt if a stage failed to process it.
+};
+
+///	@brief	Bounded queue between stages, where nullopt is the end of the stream.
+template<typename T>
+using channel_t = mpmc_queue<std::optional<packet_t<T>>>;
+
+///	@brief	Input of a pipeline.
+///		Producers are counted instead of locking the input,
+///		so that none of them blocks the end of the stream while it waits for a room.
+template<typename T>
+struct source_t {
+	static constexpr std::uint64_t finished = 1u;	 ///< Bit of the state which tells the input stream has ended.
+	static constexpr std::uint64_t producer = 2u;	 ///< Unit of the state for a producer enqueuing.
+
+	channel_t<T>			   channel;		///< Queue of the first stage.
+	std::atomic<std::uint64_t> state;		///< The number of producers enqueuing, and the finished bit.
+	std::atomic<std::uint64_t> sequence;	///< Next sequence number.
+
+	///	@brief	Starts enqueuing an item.
+	///	@return		It returns true if the input stream has not ended; otherwise, it returns false.
+	bool enter() noexcept {
+		for (auto s = state.load(); ! (s & finished);) {
+			if (state.compare_exchange_weak(s, s + producer)) return true;
+		}
+		return false;
+	}
+	///	@brief	Ends enqueuing an item.
+	void leave() noexcept {
+		// The last producer after the end puts the end of the stream after its item.
+		if (state.fetch_sub(producer) == (producer | finished)) channel.enqueue(std::nullopt);
+	}
+	///	@brief	Ends the input stream.
+	void finish() noexcept {
+		auto const s = state.fetch_or(finished);
+		if (s == 0u) channel.enqueue(std::nullopt);
+	}
+
+	///	@brief	Constructor.
+	///	@param[in]	capacity	Capacity of the queue.
+	explicit source_t(std::size_t capacity) :
+		channel{capacity}, state{}, sequence{} {}
+};
+
+///	@brief	Stage of a pipeline.
+class stage_base_t {
+public:
+	///	@brief	Discards the items left, and stops the workers.
+	virtual void abort() noexcept = 0;
+	///	@brief	Waits for the workers to finish.
+	virtual void join() noexcept = 0;
+	///	@brief	Gets a snapshot of the statistics.
+	///	@return		Statistics.
+	virtual stage_statistics_t statistics() const noexcept = 0;
+	///	@brief	Destructor.
+	virtual ~stage_base_t() noexcept = default;
+};
+
+///	@brief	Stage which processes items of type In into items of type Out, or consumes them if Out is void.
+template<typename In, typename Out>
+class stage_t final : public stage_base_t {
+public:
+	using function_t = std::function<Out(In&&)>;	///< Function to process an item.
+
+	void abort() noexcept override {
+		if constexpr (! std::is_void_v<Out>) output_->terminate();
+		input_.terminate();
+		{
+			std::lock_guard lock{mutex_};
+			aborted_ = true;
+		}
+		room_.notify_all();
+	}
+	void join() noexcept override {
+		for (auto& thread: threads_) {
+			if (thread.joinable()) thread.join();
+		}
+	}
+	stage_statistics_t statistics() const noexcept override {
+		return stage_statistics_t{threads_.size(), input_.size(), processed_.load(), failed_.load(), std::chrono::steady_clock::duration{busy_.load()}};
+	}
+	///	@brief	Gets the output queue.
+	///	@return		The output queue.
+	channel_t<Out>& output() const noexcept
+		requires(! std::is_void_v<Out>)
+	{
+		return *output_;
+	}
+
+	///	@brief	Constructor.
+	///	@param[in]	input		Input queue.
+	///	@param[in]	function	Function to process an item.
+	///	@param[in]	options		Options.
+	///	@param[in]	capacity	Capacity of the output queue, and of the results waiting for others in order.
+	stage_t(channel_t<In>& input, function_t function, stage_options_t const& options, std::size_t capacity) :
+		input_{input}, output_{}, function_{std::move(function)}, batch_{options.batch}, ordered_{options.ordered}, capacity_{capacity}, threads_{}, remaining_{options.workers}, mutex_{}, room_{}, pending_{}, running_{}, next_{}, pushing_{}, aborted_{}, processed_{}, failed_{}, busy_{} {
+		validate_argument(0u < options.workers && 0u < options.batch && static_cast<bool>(function_));
+		if constexpr (! std::is_void_v<Out>) output_ = std::make_unique<channel_t<Out>>(capacity);
+
+		threads_.reserve(options.workers);
+		try {
+			for (std::size_t i{}; i < options.workers; ++i) {
+				threads_.emplace_back([this]() { run_(); });
+			}
+		} catch (...) {
+			abort();
+			join();
+			throw;
+		}
+	}
+	///	@brief	Destructor.
+	~stage_t() noexcept override {
+		abort();
+		join();
+	}
+
+private:
+	stage_t(stage_t const&)			   = delete;
+	stage_t& operator=(stage_t const&) = delete;
+
+	using result_t = std::conditional_t<std::is_void_v<Out>, packet_t<In>, packet_t<Out>>;	  ///< Result waiting to be output.
+
+	void run_() noexcept {
+		std::vector<packet_t<In>> batch;
+		std::vector<result_t>	  results;
+		for (auto end = false; ! end;) {
+			std::optional<packet_t<In>> packet;
+			if (! input_.dequeue(packet)) return;	 // aborted
+
+			try {
+				do {
+					if (! packet) {
+						end = true;
+						break;
+					}
+					batch.emplace_back(std::move(*packet));
+				} while (batch.size() < batch_ && input_.try_dequeue(packet));
+
+				if (ordered_) take_(batch);
+				if constexpr (std::is_void_v<Out>) {
+					// Consumes the items in order one worker at a time, or at once.
+					ordered_ ? push_ordered_(batch) : process_(batch, results);
+				} else {
+					process_(batch, results);
+					ordered_ ? push_ordered_(results) : push_(results);
+				}
+			} catch (...) {
+				skip_(batch, results);
+			}
+			batch.clear();
+			results.clear();
+		}
+
+		// Puts the end back for the other workers, and the last worker passes it to the next stage.
+		if (1u < remaining_.fetch_sub(1u)) {
+			input_.enqueue(std::nullopt);
+		} else if constexpr (! std::is_void_v<Out>) {
+			output_->enqueue(std::nullopt);
+		}
+	}
+	// Processes items, or consumes them if Out is void.
+	void process_(std::vector<packet_t<In>>& batch, std::vector<result_t>& results) {
+		auto const begin = std::chrono::steady_clock::now();
+		for (auto& packet: batch) {
+			if constexpr (std::is_void_v<Out>) {
+				if (packet.value && ! invoke_(std::move(*packet.value))) failed_.fetch_add(1u);
+			} else {
+				auto& result = results.emplace_back(result_t{packet.sequence, std::nullopt});
+				if (packet.value && ! invoke_(std::move(*packet.value), result.value)) failed_.fetch_add(1u);
+			}
+		}
+		processed_.fetch_add(batch.size());
+		busy_.fetch_add((std::chrono::steady_clock::now() - begin).count());
+	}
+	// Calls the function, and returns false if it throws an exception.
+	template<typename... R>
+	bool invoke_(In&& in, R&... result) noexcept {
+		try {
+			if constexpr (std::is_void_v<Out>) {
+				function_(std::move(in));
+			} else {
+				(result.emplace(function_(std::move(in))), ...);
+			}
+			return true;
+		} catch (...) {
+			return false;
+		}
+	}
+	void push_(std::vector<result_t>& results) {
+		if constexpr (! std::is_void_v<Out>) {
+			for (auto& result: results) {
+				output_->enqueue(std::move(result));
+			}
+		}
+	}
+	// Forwards empty results for the items lost by an exception,
+	// so that the following ordered stages never wait for their sequence numbers.
+	void skip_(std::vector<packet_t<In>> const& batch, std::vector<result_t>& results) noexcept {
+		ignore_exceptions([this, &batch, &results]() {
+			results.clear();
+			for (auto const& packet: batch) {
+				results.emplace_back(result_t{packet.sequence, std::nullopt});
+			}
+			if (ordered_) {
+				push_ordered_(results);
+			} else {
+				push_(results);
+			}
+		});
+	}
+	// Marks the items of a batch in the hands of a worker.
+	void take_(std::vector<packet_t<In>> const& batch) {
+		std::lock_guard lock{mutex_};
+		for (auto const& packet: batch) {
+			running_.insert(packet.sequence);
+		}
+	}
+	// Outputs the results, or consumes the items, contiguous in the order of the input.
+	// A worker at a time outputs them without the lock, and the others leave their results to it.
+	void push_ordered_(std::vector<result_t>& results) {
+		std::unique_lock lock{mutex_};
+
+		// Results waiting for others are bounded while the next one is in the hands of a worker,
+		// but never if the next one has not been taken from the input yet, or the results have it.
+		room_.wait(lock, [this, &results]() {
+			return pending_.size() < capacity_ || aborted_ || (! pushing_ && ! running_.contains(next_)) ||
+				   std::ranges::any_of(results, [this](auto const& result) { return result.sequence == next_; });
+		});
+		for (auto& result: results) {
+			running_.erase(result.sequence);
+			// A result output already, or left already, is a duplicate of an empty one for a lost item.
+			if (next_ <= result.sequence) pending_.emplace(result.sequence, std::move(result));
+		}
+		if (pushing_) return;
+		pushing_ = true;
+
+		try {
+			for (std::vector<result_t> contiguous;; contiguous.clear()) {
+				// Reserves in advance not to lose the results taken out of the pending_.
+				contiguous.reserve(pending_.size());
+				for (auto it = pending_.begin(); it != pending_.end() && it->first == next_; it = pending_.erase(it), ++next_) {
+					contiguous.emplace_back(std::move(it->second));
+				}
+				if (contiguous.empty()) break;
+
+				// The output might wait for a room, so that the others can add their results meanwhile.
+				room_.notify_all();
+				lock.unlock();
+				if constexpr (std::is_void_v<Out>) {
+					std::vector<result_t> none;
+					process_(contiguous, none);
+				} else {
+					push_(contiguous);
+				}
+				lock.lock();
+			}
+		} catch (...) {
+			if (! lock.owns_lock()) lock.lock();
+			pushing_ = false;
+			room_.notify_all();
+			throw;
+		}
+		pushing_ = false;
+		room_.notify_all();
+	}
+
+	channel_t<In>&																input_;		   ///< Input queue.
+	std::conditional_t<std::is_void_v<Out>, std::nullptr_t, std::unique_ptr<channel_t<Out>>> output_;		   ///< Output queue.
+	function_t const															function_;	   ///< Function to process an item.
+	std::size_t const															batch_;		   ///< The maximum number of items a worker takes at once.
+	bool const																	ordered_;	   ///< Whether the stage outputs items in order.
+	std::size_t const															capacity_;	   ///< The number of results waiting for others to block the workers.
+	std::vector<std::thread>													threads_;	   ///< Workers.
+	std::atomic<std::size_t>													remaining_;	   ///< The number of workers running.
+	std::mutex																	mutex_;		   ///< Mutex of the results waiting for others.
+	std::condition_variable														room_;		   ///< Condition to wait for the results waiting for others to decrease.
+	std::map<std::uint64_t, result_t>											pending_;	   ///< Results waiting for others.
+	std::set<std::uint64_t>														running_;	   ///< Sequence numbers of the items in the hands of the workers.
+	std::uint64_t																next_;		   ///< Sequence number to output next.
+	bool																		pushing_;	   ///< Whether a worker is outputting the results.
+	bool																		aborted_;	   ///< Whether the stage is aborted.
+	std::atomic<std::uint64_t>													processed_;	   ///< The number of items processed.
+	std::atomic<std::uint64_t>													failed_;	   ///< The number of items failed.
+	std::atomic<std::chrono::steady_clock::rep>									busy_;		   ///< Total time spent processing items.
+};
+
+}	 // namespace impl
+
+///	@brief	Pipeline of stages connected by bounded queues.
+///		Each stage has its own workers, which take items from the queue of the stage in batches,
+///		and push the results to the queue of the next stage.
+///		The pipeline takes items of type In, and outputs items of type Out unless the last stage consumes them.
+///		A stage with ordered output puts its results in the order of the input of the pipeline,
+///		so that even after stages with unordered output, the order is restored.
+///		An item which a stage throws an exception for is dropped, and counted in the statistics.
+///	@tparam		In		Type of input, which is nothrow move constructible.
+///	@tparam		Out		Type of output, which is nothrow move constructible, or void.
+///	@code
+///		auto p = xxx::pipeline<std::string>{}
+///			.then([](std::string&& line) { return parse(line); }, {.workers = 4u, .batch = 16u})
+///			.then([](record_t&& r) { return enrich(r); }, {.workers = 2u, .ordered = true})
+///			.then([](record_t&& r) { write(r); });
+///	@endcode
+template<typename In, typename Out = In>
+class pipeline {
+public:
+	///	@brief	Appends a stage.
+	///	@param[in]	f			Function to process an item, which returns the result or void to consume it.
+	///	@param[in]	options		Options of the stage.
+	///	@return		The pipeline with the stage.
+	template<typename F>
+	auto then(F&& f, stage_options_t const& options = {}) && -> pipeline<In, std::invoke_result_t<F&, std::add_rvalue_reference_t<Out>>> {
+		static_assert(! std::is_void_v<Out>, "The last stage consumes items.");
+		using result_t = std::invoke_result_t<F&, Out&&>;
+
+		stages_.reserve(stages_.size() + 1u);
+		auto stage = std::make_unique<impl::stage_t<Out, result_t>>(*output_, std::forward<F>(f), options, capacity_);
+		pipeline<In, result_t> next{capacity_, std::move(source_)};
+		if constexpr (! std::is_void_v<result_t>) next.output_ = &stage->output();
+		next.stages_ = std::move(stages_);
+		next.stages_.emplace_back(std::move(stage));
+		return next;
+	}
+	///	@brief	Enqueues an item.
+	///		If the queue of the first stage is full, this method waits a room.
+	///	@param[in]	in	Item.
+	///	@return		It returns true if queued; otherwise, it returns false because terminated.
+	bool enqueue(In in) {
+		if (! source_->enter()) return false;
+		auto const queued = source_->channel.enqueue(impl::packet_t<In>{source_->sequence++, std::move(in)});
+		source_->leave();
+		return queued;
+	}
+	///	@brief	Dequeues an output of the last stage.
+	///		If no output is ready, this method waits a new one.
+	///	@param[in]	out		Output.
+	///	@return		It returns true if dequeued; otherwise, it returns false because the stream has ended.
+	template<typename O = Out>
+	bool dequeue(O& out)
+		requires(std::is_same_v<O, Out> && ! std::is_void_v<Out>)
+	{
+		for (std::optional<impl::packet_t<Out>> packet; output_->dequeue(packet);) {
+			if (! packet) {
+				// Puts the end back for the other consumers.
+				output_->enqueue(std::nullopt);
+				return false;
+			}
+			if (packet->value) {
+				out = std::move(*packet->value);
+				return true;
+			}
+		}
+		return false;
+	}
+	///	@brief	Ends the input stream.
+	///		The end of the stream propagates through the stages after they process the items left,
+	///		and dequeue() returns false after the last output.
+	///		It does not wait for producers waiting for a room; the end follows their items.
+	void terminate() noexcept { source_->finish(); }
+	///	@brief	Waits for all the stages to process the items left after terminate().
+	void wait() noexcept {
+		for (auto& stage: stages_) {
+			stage->join();
+		}
+	}
+	///	@brief	Is the input stream terminated?
+	///	@return		It returns true if it has been terminated; otherwise, it returns false.
+	bool terminated() const noexcept { return source_->state.load() & impl::source_t<In>::finished; }
+	///	@brief	Gets snapshots of the statistics of the stages.
+	///		A stage with large backlog and busy time is the bottleneck.
+	///	@return		Statistics of each stage.
+	std::vector<stage_statistics_t> statistics() const {
+		std::vector<stage_statistics_t> statistics;
+		statistics.reserve(stages_.size());
+		for (auto const& stage: stages_) {
+			statistics.emplace_back(stage->statistics());
+		}
+		return statistics;
+	}
+
+	///	@brief	Constructor.
+	///	@param[in]	capacity	Capacity of the queue of each stage, and of the results a stage with ordered output holds.
+	explicit pipeline(std::size_t capacity = 1024u) :
+		capacity_{capacity}, source_{std::make_unique<impl::source_t<In>>(capacity)}, stages_{}, output_{} {
+		if constexpr (std::is_same_v<In, Out>) output_ = &source_->channel;
+	}
+	///	@brief	Move constructor.
+	pipeline(pipeline&&) noexcept = default;
+	///	@brief	Destructor.
+	///		The items left are discarded.
+	~pipeline() noexcept {
+		if (! source_) return;	  // moved
+		source_->channel.terminate();
+		for (auto& stage: stages_) {
+			stage->abort();
+		}
+		wait();
+
+		// Each stage refers to the queue of the previous stage.
+		while (! stages_.empty()) {
+			stages_.pop_back();
+		}
+	}
+
+private:
+	template<typename, typename>
+	friend class pipeline;
+
+	pipeline(pipeline const&)			 = delete;
+	pipeline& operator=(pipeline const&) = delete;
+	pipeline& operator=(pipeline&&)		 = delete;
+
+	pipeline(std::size_t capacity, std::unique_ptr<impl::source_t<In>> source) noexcept :
+		capacity_{capacity}, source_{std::move(source)}, stages_{}, output_{} {}
+
+	std::size_t const														  capacity_;   ///< Capacity of the queue of each stage.
+	std::unique_ptr<impl::source_t<In>>										  source_;	   ///< Input of the pipeline.
+	std::vector<std::unique_ptr<impl::stage_base_t>>						  stages_;	   ///< Stages.
+	std::conditional_t<std::is_void_v<Out>, std::nullptr_t, impl::channel_t<Out>*> output_;	   ///< Output queue.
+};
+
+}	 // namespace xxx
+
+#endif	  // xxx_PIPELINE_HXX_
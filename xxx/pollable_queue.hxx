@@ -0,0 +1,185 @@
+///	@file
+///	@brief		xxx common library.
+///	@details	Event queue which notifies readiness through a file descriptor.
+///	@pre		ISO/IEC 14882:2020 or higher
+///	@author		Mura
+///	@copyright	(C) 2023-, Mura. All rights reserved. (MIT License)
+
+#ifndef xxx_POLLABLE_QUEUE_HXX_
+#define xxx_POLLABLE_QUEUE_HXX_
+
+#include <xxx/queue.hxx>
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <ranges>
+#include <system_error>
+#include <utility>
+
+#if defined(xxx_posix)
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+
+namespace xxx {
+
+///	@brief	Event queue for event loops, which exposes a pollable file descriptor.
+///		The descriptor becomes readable when events are enqueued,
+///		and stays readable until a consumer finds this queue empty.
+///		Notifications are coalesced, so that only the first enqueue after the queue is found empty makes a system call.
+///		It is an eventfd on Linux, or a pipe on the other POSIX systems, and it is not available on the other platforms.
+///		The enqueue() and dequeue() behave the same as the xxx::queue,
+///		and the terminate() makes the descriptor readable to wake the event loop up.
+///	@tparam		T	Type of event.
+template<typename T>
+class pollable_queue {
+public:
+	using value_type = T;	 ///< Type of event.
+
+	/// @brief 	Enqueues an event.
+	/// @param[in]	t	The event to push.
+	/// @return	It returns true if queued; otherwise, it returns false.
+	bool enqueue(T const& t) { return queue_.enqueue(t) && arm_(); }
+	/// @brief 	Enqueues an event.
+	/// @param[in]	t	The event to push.
+	/// @return	It returns true if queued; otherwise, it returns false.
+	bool enqueue(T&& t) { return queue_.enqueue(std::move(t)) && arm_(); }
+	/// @brief 	Constructs an event in place.
+	/// @param[in]	args	Arguments to construct the event.
+	/// @return	It returns true if queued; otherwise, it returns false.
+	template<typename... Args>
+	bool emplace(Args&&... args) { return queue_.emplace(std::forward<Args>(args)...) && arm_(); }
+	/// @brief 	Enqueues events at once.
+	///		It notifies the descriptor only once.
+	/// @param[in]	range	The events to push.
+	/// @return	It returns true if queued; otherwise, it returns false.
+	template<std::ranges::input_range R>
+	bool enqueue_bulk(R&& range) { return queue_.enqueue_bulk(std::forward<R>(range)) && arm_(); }
+	/// @brief 	Dequeues an event.
+	///		If this queue is empty, this method waits a new event.
+	/// @param[in]	t	Next event.
+	/// @return	It returns true if dequeued; otherwise, it returns false.
+	bool dequeue(T& t) { return queue_.dequeue(t); }
+	/// @brief 	Dequeues an event if this queue is not empty.
+	///		If this queue is empty, the descriptor is reset until the next enqueue.
+	/// @param[in]	t	Next event.
+	/// @return	It returns true if dequeued; otherwise, it returns false.
+	bool try_dequeue(T& t) {
+		if (queue_.try_dequeue(t)) return true;
+		disarm_();
+		return false;
+	}
+	/// @brief 	Dequeues events at once if this queue is not empty.
+	///		If this queue runs out, the descriptor is reset until the next enqueue.
+	///		An event loop can drain a burst of events with a single call.
+	/// @param[out]	out		Output iterator to store the events.
+	/// @param[in]	max		The maximum number of events to dequeue.
+	/// @return	The number of dequeued events.
+	template<std::output_iterator<T&&> O>
+	std::size_t try_dequeue_bulk(O out, std::size_t max) {
+		auto const n = queue_.try_dequeue_bulk(out, max);
+		if (n < max) disarm_();
+		return n;
+	}
+	/// @brief 	Terminates this queue.
+	///		Waiting consumers return false, the events left are discarded, and the descriptor becomes readable.
+	void terminate() noexcept {
+		queue_.terminate();
+		armed_.store(true);
+		signal_();
+	}
+	/// @brief 	Is this queue empty?
+	/// @return		It returns true if the queue is empty; otherwise, it returns false.
+	bool empty() const noexcept { return queue_.empty(); }
+	/// @brief 	Is this queue terminated?
+	/// @return		It returns true if the queue has been terminated; otherwise, it returns false.
+	bool terminated() const noexcept { return queue_.terminated(); }
+	/// @brief 	Gets the descriptor to poll for reading, which is owned by this queue.
+	/// @return		The file descriptor.
+	int native_handle() const noexcept { return reader_; }
+
+	///	@brief	Constructor.
+	///	@throw		If the descriptor was failed to create, it throws a system error exception.
+	pollable_queue() :
+		queue_{}, armed_{}, reader_{-1}, writer_{-1} {
+#if defined(__linux__)
+		reader_ = writer_ = ::eventfd(0u, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (reader_ < 0) throw std::system_error{std::error_code{errno, std::system_category()}, "eventfd"};
+#else
+		int fds[2];
+		if (::pipe(fds) != 0) throw std::system_error{std::error_code{errno, std::system_category()}, "pipe"};
+		reader_ = fds[0];
+		writer_ = fds[1];
+		for (auto const fd: fds) {
+			::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+			::fcntl(fd, F_SETFD, FD_CLOEXEC);
+		}
+#endif
+	}
+	///	@brief	Destructor.
+	~pollable_queue() noexcept {
+		queue_.terminate();
+		if (writer_ != reader_) ::close(writer_);
+		::close(reader_);
+	}
+
+private:
+	pollable_queue(pollable_queue const&)			 = delete;
+	pollable_queue& operator=(pollable_queue const&) = delete;
+
+	// Makes the descriptor readable unless it has been already.
+	bool arm_() noexcept {
+		// Pairs with the fence in the disarm_().
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (! armed_.exchange(true)) signal_();
+		return true;
+	}
+	// Resets the descriptor after the queue is found empty.
+	void disarm_() noexcept {
+		if (terminated()) return;
+
+		// The descriptor is drained before the flag is cleared,
+		// so that the notification of a producer which sees the flag cleared is never drained.
+		drain_();
+		armed_.store(false);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		// A producer which has seen the flag set before it is cleared did not notify, then notifies instead of it.
+		if (! queue_.empty()) arm_();
+	}
+	// Makes the descriptor readable.
+	void signal_() noexcept {
+#if defined(__linux__)
+		std::uint64_t const value = 1u;
+#else
+		char const value = 0;
+#endif
+		// It fails only if the descriptor is readable already.
+		[[maybe_unused]] auto const result = ::write(writer_, &value, sizeof value);
+	}
+	// Makes the descriptor unreadable.
+	void drain_() noexcept {
+		std::uint64_t buffer[16];
+		while (0 < ::read(reader_, buffer, sizeof buffer)) {
+#if defined(__linux__)
+			break;
+#endif
+		}
+	}
+
+	queue<T>		  queue_;	 ///< Queue.
+	std::atomic<bool> armed_;	 ///< Whether the descriptor is readable.
+	int				  reader_;	 ///< Descriptor to read.
+	int				  writer_;	 ///< Descriptor to write, which is the same as the reader_ for an eventfd.
+};
+
+}	 // namespace xxx
+
+#endif	  // defined(xxx_posix)
+
+#endif	  // xxx_POLLABLE_QUEUE_HXX_
@@ -0,0 +1,212 @@
+///	@file
+///	@brief		xxx common library.
+///	@details	Concurrent priority queue.
+///	@pre		ISO/IEC 14882:2020 or higher
+///	@author		Mura
+///	@copyright	(C) 2023-, Mura. All rights reserved. (MIT License)
+
+#ifndef xxx_PRIORITY_QUEUE_HXX_
+#define xxx_PRIORITY_QUEUE_HXX_
+
+#include <xxx/exceptions.hxx>
+#include <xxx/queue.hxx>
+
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace xxx {
+
+///	@brief	Event queue prioritizing events.
+///		Each priority level has its own lane, so that producers of different levels never contend.
+///		Consumers take the front event of the highest level, where zero is the highest,
+///		and events of the same level are first-in first-out.
+///		To avoid starvation, an event which waits longer than the aging time overtakes the higher levels.
+///		The enqueue(), dequeue() and terminate() behave the same as the xxx::queue.
+template<typename T>
+class priority_queue {
+public:
+	using priority_t = std::function<std::size_t(T const&)>;	///< Gets the level of an event.
+	using clock_t	 = std::chrono::steady_clock;				///< Clock to measure aging.
+
+	/// @brief 	Enqueues an event at the level given by the priority function.
+	/// @param[in]	t	The event to push.
+	/// @return	It returns true if queued; otherwise, it returns false.
+	bool enqueue(T const& t) { return push_(level_of_(t), t); }
+	/// @brief 	Enqueues an event at the level given by the priority function.
+	/// @param[in]	t	The event to push.
+	/// @return	It returns true if queued; otherwise, it returns false.
+	bool enqueue(T&& t) {
+		auto const level = level_of_(t);
+		return push_(level, std::move(t));
+	}
+	/// @brief 	Enqueues an event at the level.
+	/// @param[in]	level	Priority level; zero is the highest.
+	/// @param[in]	t		The event to push.
+	/// @return	It returns true if queued; otherwise, it returns false.
+	bool enqueue(std::size_t level, T const& t) { return push_(level, t); }
+	/// @brief 	Enqueues an event at the level.
+	/// @param[in]	level	Priority level; zero is the highest.
+	/// @param[in]	t		The event to push.
+	/// @return	It returns true if queued; otherwise, it returns false.
+	bool enqueue(std::size_t level, T&& t) { return push_(level, std::move(t)); }
+	/// @brief 	Dequeues the event of the highest priority.
+	///		If this queue is empty, this method waits a new event.
+	/// @param[in]	t	Next event.
+	/// @return	It returns true if dequeued; otherwise, it returns false.
+	bool dequeue(T& t) {
+		for (;;) {
+			if (terminated()) return false;
+			if (try_dequeue(t)) return true;
+
+			// Registers as a waiter before checking the queue again,
+			// so that a producer surely sees the waiter or this consumer surely sees the event.
+			auto const signal = signal_.load();
+			waiters_.fetch_add(1u);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (empty() && ! terminated()) {
+				signal_.wait(signal);
+			}
+			waiters_.fetch_sub(1u);
+		}
+	}
+	/// @brief 	Dequeues the event of the highest priority if this queue is not empty.
+	/// @param[in]	t	Next event.
+	/// @return	It returns true if dequeued; otherwise, it returns false.
+	bool try_dequeue(T& t) {
+		for (;;) {
+			if (terminated()) return false;
+			auto const mask = mask_.load(std::memory_order_acquire);
+			if (mask == 0u) return false;
+
+			auto const level = 0 < aging_.count() ? choose_aged_(mask) : static_cast<std::size_t>(std::countr_zero(mask));
+			auto&	   lane	 = lanes_[level];
+
+			std::lock_guard lock{lane.mutex};
+			if (lane.events.empty()) continue;	  // Another consumer took it.
+			t = std::move(lane.events.front().second);	  // might cause an exception.
+			lane.events.pop_front();
+			update_(lane, level);
+			return true;
+		}
+	}
+	/// @brief 	Terminates this queue.
+	///		Waiting consumers return false, and the events left are discarded.
+	void terminate() noexcept {
+		finished_.store(true);
+		for (std::size_t level{}; level < levels_; ++level) {
+			auto&			lane = lanes_[level];
+			std::lock_guard lock{lane.mutex};
+			lane.events.clear();
+			update_(lane, level);
+		}
+		signal_.fetch_add(1u);
+		signal_.notify_all();
+	}
+	/// @brief 	Is this queue empty?
+	/// @return		It returns true if the queue is empty; otherwise, it returns false.
+	bool empty() const noexcept { return mask_.load() == 0u; }
+	/// @brief 	Is this queue terminated?
+	/// @return		It returns true if the queue has been terminated; otherwise, it returns false.
+	bool terminated() const noexcept { return finished_.load(); }
+	/// @brief 	Gets the number of priority levels.
+	/// @return		The number of priority levels.
+	std::size_t levels() const noexcept { return levels_; }
+
+	/// @brief 	Constructor.
+	/// @param[in]	levels		The number of priority levels, up to 64.
+	/// @param[in]	priority	Function to get the level of an event, which is required to enqueue events without their levels.
+	/// @param[in]	aging		Time for an event to overtake the higher levels, or zero not to overtake.
+	explicit priority_queue(std::size_t levels, priority_t priority = nullptr, clock_t::duration aging = clock_t::duration::zero()) :
+		levels_{levels}, lanes_{}, priority_{std::move(priority)}, aging_{aging}, mask_{}, signal_{}, waiters_{}, finished_{} {
+		validate_argument(0u < levels && levels <= std::numeric_limits<std::uint64_t>::digits);
+		lanes_ = std::make_unique<lane_t[]>(levels);
+	}
+	/// @brief 	Destructor.
+	~priority_queue() noexcept { terminate(); }
+
+private:
+	priority_queue(priority_queue const&)			 = delete;
+	priority_queue& operator=(priority_queue const&) = delete;
+
+	///	@brief	Lane of a priority level.
+	struct alignas(cache_line_size) lane_t {
+		std::mutex									   mutex;	  ///< Mutex.
+		std::deque<std::pair<clock_t::time_point, T>> events;	  ///< Events and their enqueued time.
+		std::atomic<clock_t::rep>					   since{};	  ///< Enqueued time of the front event.
+	};
+
+	std::size_t level_of_(T const& t) const {
+		validate_argument(static_cast<bool>(priority_));
+		return priority_(t);
+	}
+	template<typename U>
+	bool push_(std::size_t level, U&& u) {
+		validate_argument(level < levels_);
+		if (terminated()) return false;
+
+		auto const now = 0 < aging_.count() ? clock_t::now() : clock_t::time_point{};
+		{
+			auto&			lane = lanes_[level];
+			std::lock_guard lock{lane.mutex};
+			lane.events.emplace_back(now, std::forward<U>(u));
+			if (lane.events.size() == 1u) {
+				update_(lane, level);
+			}
+		}
+
+		// Pairs with the fence of the waiter.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (0u < waiters_.load(std::memory_order_relaxed)) {
+			signal_.fetch_add(1u);
+			signal_.notify_one();
+		}
+		return true;
+	}
+	// Updates the mask and the time of the front event under the lock of the lane.
+	void update_(lane_t& lane, std::size_t level) noexcept {
+		auto const bit = std::uint64_t{1u} << level;
+		if (lane.events.empty()) {
+			mask_.fetch_and(~bit);
+		} else {
+			lane.since.store(lane.events.front().first.time_since_epoch().count(), std::memory_order_relaxed);
+			mask_.fetch_or(bit);
+		}
+	}
+	// Chooses the lane of the oldest event among the aged ones, or the highest level.
+	std::size_t choose_aged_(std::uint64_t mask) const noexcept {
+		auto const limit = (clock_t::now() - aging_).time_since_epoch().count();
+
+		auto chosen = static_cast<std::size_t>(std::countr_zero(mask));
+		auto oldest = limit;
+		for (auto m = mask; m != 0u; m &= m - 1u) {
+			auto const level = static_cast<std::size_t>(std::countr_zero(m));
+			if (auto const since = lanes_[level].since.load(std::memory_order_relaxed); since <= oldest) {
+				chosen = level;
+				oldest = since;
+			}
+		}
+		return chosen;
+	}
+
+	std::size_t const									levels_;	  ///< The number of priority levels.
+	std::unique_ptr<lane_t[]>							lanes_;		  ///< Lanes of each level.
+	priority_t const									priority_;	  ///< Function to get the level of an event.
+	clock_t::duration const								aging_;		  ///< Time for an event to overtake the higher levels.
+	alignas(cache_line_size) std::atomic<std::uint64_t> mask_;		  ///< Bits of non-empty lanes.
+	std::atomic<std::uint32_t>							signal_;	  ///< Epoch for consumers to wait.
+	std::atomic<std::uint32_t>							waiters_;	  ///< The number of waiting consumers.
+	std::atomic<bool>									finished_;	  ///< Finished flag.
+};
+
+}	 // namespace xxx
+
+#endif	  // xxx_PRIORITY_QUEUE_HXX_
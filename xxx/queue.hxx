@@ -9,25 +9,303 @@
 #ifndef xxx_QUEUE_HXX_
 #define xxx_QUEUE_HXX_
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <deque>
+#include <iterator>
+#include <limits>
+#include <memory>
 #include <mutex>
+#include <new>
+#include <optional>
+#include <ranges>
 #include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 namespace xxx {
 
-///	@brief	Event queue.
+class queue_selector_t;
+
+///	@brief	Size of cache line to keep variables shared between threads apart.
+inline constexpr std::size_t cache_line_size{64u};
+
+namespace impl {
+
+///	@brief	Pool of memory blocks.
+///		Blocks are carved out of chunks allocated at once, and freed blocks are kept to be reused,
+///		so that it stops allocating heap memory once it has enough blocks of each size.
+class block_pool_t {
+public:
+	///	@brief	Allocates a block.
+	///	@param[in]	size	Size of the block in bytes.
+	///	@param[in]	align	Alignment of the block.
+	///	@return		The block.
+	void* allocate(std::size_t size, std::size_t align) {
+		std::lock_guard lock{mutex_};
+		auto&			list = get_list_(size, align);
+		if (! list.head) {
+			grow_(list);
+		}
+		auto* const block = list.head;
+		list.head		  = block->next;
+		return block;
+	}
+	///	@brief	Deallocates a block to reuse.
+	///	@param[in]	p		The block.
+	///	@param[in]	size	Size of the block in bytes.
+	///	@param[in]	align	Alignment of the block.
+	void deallocate(void* p, std::size_t size, std::size_t align) noexcept {
+		std::lock_guard lock{mutex_};
+		auto&			list = get_list_(size, align);	  // It has been already allocated.
+		auto* const		block{static_cast<block_t*>(p)};
+		block->next = list.head;
+		list.head	= block;
+	}
+
+	///	@brief	Constructor.
+	block_pool_t() :
+		mutex_{}, lists_{}, chunks_{} {}
+	///	@brief	Destructor.
+	~block_pool_t() {
+		for (auto const& chunk: chunks_) {
+			::operator delete(chunk.first, std::align_val_t{chunk.second});
+		}
+	}
+
+private:
+	block_pool_t(block_pool_t const&)			 = delete;
+	block_pool_t& operator=(block_pool_t const&) = delete;
+
+	struct block_t {
+		block_t* next;	  ///< Next free block.
+	};
+	struct list_t {
+		std::size_t size;	  ///< Size of blocks.
+		std::size_t align;	  ///< Alignment of blocks.
+		std::size_t count;	  ///< The number of blocks to allocate next time.
+		block_t*	head;	  ///< The first free block.
+	};
+
+	list_t& get_list_(std::size_t size, std::size_t align) {
+		align = std::max(align, alignof(block_t));
+		size  = (std::max(size, sizeof(block_t)) + align - 1u) / align * align;
+		for (auto& list: lists_) {
+			if (list.size == size && list.align == align) return list;
+		}
+		return lists_.emplace_back(list_t{size, align, 1u, nullptr});
+	}
+	void grow_(list_t& list) {
+		chunks_.reserve(chunks_.size() + 1u);
+		auto* const chunk = static_cast<std::byte*>(::operator new(list.size * list.count, std::align_val_t{list.align}));
+		chunks_.emplace_back(chunk, list.align);
+		for (std::size_t i{}; i < list.count; ++i) {
+			auto* const block = ::new (static_cast<void*>(chunk + list.size * i)) block_t{list.head};
+			list.head		  = block;
+		}
+		list.count = std::min(list.count * 2u, std::size_t{64u});	 // It is a magic number.
+	}
+
+	std::mutex								  mutex_;	  ///< Mutex.
+	std::vector<list_t>						  lists_;	  ///< Free lists of each size.
+	std::vector<std::pair<void*, std::size_t>> chunks_;	  ///< Allocated chunks and their alignment.
+};
+
+///	@brief	Allocator with a pool of memory blocks.
+///		It shares the pool with its copies, and falls back to the global heap without any pool.
 template<typename T>
+class pool_allocator_t {
+public:
+	using value_type							 = T;				  ///< Type of value.
+	using propagate_on_container_copy_assignment = std::true_type;	  ///< The pool follows the container.
+	using propagate_on_container_move_assignment = std::true_type;	  ///< The pool follows the container.
+	using propagate_on_container_swap			 = std::true_type;	  ///< The pool follows the container.
+
+	///	@brief	Allocates memory for objects.
+	///	@param[in]	n	The number of objects.
+	///	@return		The memory.
+	T* allocate(std::size_t n) {
+		if (std::numeric_limits<std::size_t>::max() / sizeof(T) < n) throw std::bad_array_new_length();
+		if (! pool_) return std::allocator<T>{}.allocate(n);
+		return static_cast<T*>(pool_->allocate(sizeof(T) * n, alignof(T)));
+	}
+	///	@brief	Deallocates memory.
+	///	@param[in]	p	The memory.
+	///	@param[in]	n	The number of objects.
+	void deallocate(T* p, std::size_t n) noexcept {
+		if (! pool_) return std::allocator<T>{}.deallocate(p, n);
+		pool_->deallocate(p, sizeof(T) * n, alignof(T));
+	}
+	///	@brief	Gets the pool.
+	///	@return		The pool, or null if it uses the global heap.
+	std::shared_ptr<block_pool_t> const& pool() const noexcept { return pool_; }
+
+	///	@brief	Compares allocators.
+	///	@param[in]	lhs		An allocator.
+	///	@param[in]	rhs		Another allocator.
+	///	@return		It returns true if they share the same pool; otherwise, it returns false.
+	template<typename U>
+	friend bool operator==(pool_allocator_t const& lhs, pool_allocator_t<U> const& rhs) noexcept { return lhs.pool() == rhs.pool(); }
+
+	///	@brief	Constructor without any pool.
+	pool_allocator_t() noexcept :
+		pool_{} {}
+	///	@brief	Constructor.
+	///	@param[in]	pool	Pool of memory blocks.
+	explicit pool_allocator_t(std::shared_ptr<block_pool_t> pool) noexcept :
+		pool_{std::move(pool)} {}
+	///	@brief	Copy constructor.
+	///		It has no move constructor because a moved allocator has to deallocate memory, too.
+	///	@param[in]	other	Allocator to share the pool.
+	pool_allocator_t(pool_allocator_t const& other) noexcept = default;
+	///	@brief	Copy assignment.
+	///	@param[in]	other	Allocator to share the pool.
+	///	@return		This allocator.
+	pool_allocator_t& operator=(pool_allocator_t const& other) noexcept = default;
+	///	@brief	Copy constructor for another type.
+	///	@param[in]	other	Allocator to share the pool.
+	template<typename U>
+	pool_allocator_t(pool_allocator_t<U> const& other) noexcept :
+		pool_{other.pool()} {}
+
+private:
+	std::shared_ptr<block_pool_t> pool_;	///< Pool of memory blocks.
+};
+
+///	@brief	Listener which is notified when a queue gets an event or is terminated.
+struct queue_listener_t {
+	std::mutex				mutex;		  ///< Mutex.
+	std::condition_variable condition;	  ///< Condition to wait for notifications.
+
+	///	@brief	Notifies the waiting thread.
+	void notify() noexcept {
+		{
+			// Locks the mutex, so that a notification is never lost between checking queues and waiting.
+			std::lock_guard lock{mutex};
+		}
+		condition.notify_all();
+	}
+};
+
+///	@brief	Tells the processor that the thread is busy-waiting.
+inline void pause() noexcept {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	_mm_pause();
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	__builtin_ia32_pause();
+#elif defined(__GNUC__) && defined(__aarch64__)
+	asm volatile("yield");
+#endif
+}
+
+}	 // namespace impl
+
+///	@brief	Statistics of an instrumented event queue.
+struct queue_statistics_t {
+	using duration_t = std::chrono::steady_clock::duration;	   ///< Type of time.
+
+	std::size_t	  depth;		  ///< The number of events in the queue.
+	std::size_t	  high_water;	  ///< The maximum number of events ever in the queue.
+	std::uint64_t enqueued;		  ///< The number of enqueued events.
+	std::uint64_t dequeued;		  ///< The number of dequeued events, excluding the discarded ones.
+	duration_t	  blocked;		  ///< Total time consumers spent waiting events.
+	duration_t	  latency;		  ///< Total time the dequeued events spent in the queue.
+	duration_t	  max_latency;	  ///< The longest time an event spent in the queue.
+};
+
+namespace impl {
+
+///	@brief	Counters of an event queue, which do nothing unless enabled.
+template<bool Enabled>
+class queue_counters_t {
+public:
+	using clock_t = std::chrono::steady_clock;	  ///< Clock to measure time.
+
+	void pushed(std::size_t, std::size_t) noexcept {}
+	void popped(std::size_t) noexcept {}
+	void blocked(clock_t::duration) noexcept {}
+	void clear() noexcept {}
+};
+
+///	@brief	Counters of an event queue, which are updated under the lock of the queue.
+template<>
+class queue_counters_t<true> {
+public:
+	using clock_t = std::chrono::steady_clock;	  ///< Clock to measure time.
+
+	///	@brief	Counts enqueued events.
+	///	@param[in]	n		The number of enqueued events.
+	///	@param[in]	depth	The number of events in the queue.
+	void pushed(std::size_t n, std::size_t depth) {
+		stamps_.insert(stamps_.end(), n, clock_t::now());	 // might cause an exception.
+		enqueued_ += n;
+		high_water_ = std::max(high_water_, depth);
+	}
+	///	@brief	Counts dequeued events, and measures how long they were in the queue.
+	///	@param[in]	n	The number of dequeued events.
+	void popped(std::size_t n) noexcept {
+		auto const now = clock_t::now();
+		for (std::size_t i{}; i < n && ! stamps_.empty(); ++i) {
+			auto const latency = now - stamps_.front();
+			latency_ += latency;
+			max_latency_ = std::max(max_latency_, latency);
+			stamps_.pop_front();
+		}
+		dequeued_ += n;
+	}
+	///	@brief	Adds time a consumer spent waiting events.
+	///	@param[in]	time	Time.
+	void blocked(clock_t::duration time) noexcept { blocked_ += time; }
+	///	@brief	Forgets the events discarded.
+	void clear() noexcept { stamps_.clear(); }
+	///	@brief	Gets a snapshot.
+	///	@param[in]	depth	The number of events in the queue.
+	///	@return		Statistics.
+	queue_statistics_t statistics(std::size_t depth) const noexcept {
+		return queue_statistics_t{depth, high_water_, enqueued_, dequeued_, blocked_, latency_, max_latency_};
+	}
+
+private:
+	std::deque<clock_t::time_point> stamps_{};		   ///< Enqueued time of each event in the queue.
+	std::size_t						high_water_{};	   ///< The maximum number of events.
+	std::uint64_t					enqueued_{};	   ///< The number of enqueued events.
+	std::uint64_t					dequeued_{};	   ///< The number of dequeued events.
+	clock_t::duration				blocked_{};		   ///< Total time consumers spent waiting.
+	clock_t::duration				latency_{};		   ///< Total time events spent in the queue.
+	clock_t::duration				max_latency_{};	   ///< The longest time an event spent in the queue.
+};
+
+}	 // namespace impl
+
+///	@brief	Event queue.
+///	@tparam		T				Type of event.
+///	@tparam		Instrumented	Whether the queue counts events and measures time for statistics().
+///								Without it, the queue has no overhead of instrumentation.
+template<typename T, bool Instrumented = false>
 class queue {
 public:
+	using value_type	 = T;								  ///< Type of event.
+	using allocator_type = impl::pool_allocator_t<T>;		  ///< Type of allocator, which pools memory blocks.
+	using container_type = std::deque<T, allocator_type>;	  ///< Type of container to store events.
+
 	/// @brief 	Enqueues an event.
 	/// @param[in]	t	The event to push.
 	/// @return	It returns true if queued; otherwise, it returns false.
 	bool enqueue(T const& t) {
 		std::lock_guard lock{mutex_};
 		if (finished_) return false;
+		auto const size = queue_.size();
 		queue_.push_back(t);
-		condition_.notify_one();
+		pushed_(size);
 		return true;
 	}
 	/// @brief 	Enqueues an event.
@@ -36,8 +314,52 @@ public:
 	bool enqueue(T&& t) {
 		std::lock_guard lock{mutex_};
 		if (finished_) return false;
+		auto const size = queue_.size();
 		queue_.emplace_back(std::move(t));
-		condition_.notify_one();
+		pushed_(size);
+		return true;
+	}
+	/// @brief 	Constructs an event in place.
+	/// @param[in]	args	Arguments to construct the event.
+	/// @return	It returns true if queued; otherwise, it returns false.
+	template<typename... Args>
+	bool emplace(Args&&... args) {
+		std::lock_guard lock{mutex_};
+		if (finished_) return false;
+		auto const size = queue_.size();
+		queue_.emplace_back(std::forward<Args>(args)...);
+		pushed_(size);
+		return true;
+	}
+	/// @brief 	Enqueues events at once.
+	///		It takes the lock and notifies consumers only once.
+	///		The events are moved from an owning range passed as an rvalue, and copied from views and borrowed ranges.
+	///		If an event fails to be queued, none of them is queued.
+	/// @param[in]	range	The events to push.
+	/// @return	It returns true if queued; otherwise, it returns false.
+	template<std::ranges::input_range R>
+	bool enqueue_bulk(R&& range) {
+		// Moving from a view or a borrowed range would empty the elements it refers to.
+		constexpr auto movable = std::is_rvalue_reference_v<R&&> && ! std::ranges::view<std::remove_cvref_t<R>> && ! std::ranges::borrowed_range<R>;
+
+		std::lock_guard lock{mutex_};
+		if (finished_) return false;
+		auto const size = queue_.size();
+		try {
+			// The sentinel might differ from the iterator.
+			auto const last = std::ranges::end(range);
+			for (auto it = std::ranges::begin(range); it != last; ++it) {
+				if constexpr (movable) {
+					queue_.emplace_back(std::ranges::iter_move(it));
+				} else {
+					queue_.emplace_back(*it);
+				}
+			}
+		} catch (...) {
+			queue_.erase(std::next(queue_.begin(), static_cast<std::ptrdiff_t>(size)), queue_.end());
+			throw;
+		}
+		pushed_(size);
 		return true;
 	}
 	/// @brief 	Dequeues an event.
@@ -46,23 +368,116 @@ public:
 	/// @return	It returns true if dequeued; otherwise, it returns false.
 	bool dequeue(T& t) {
 		std::unique_lock lock{mutex_};
-		while (queue_.empty()) {
-			if (finished_) return false;
-			condition_.wait(lock);
-		}
+		wait_(lock, nullptr);
 		if (finished_) return false;
-		t = queue_.front();	   // might cause an exception.
-		queue_.pop_front();
+		pop_(t);
 		return true;
 	}
 	/// @brief 	Dequeues an event.
-	///		If this queue is empty, this method waits a new event.
+	///		If this queue is empty, this method waits a new event until the timeout.
+	/// @param[in]	t		Next event.
+	/// @param[in]	timeout	Timeout.
+	/// @return	It returns true if dequeued; otherwise, it returns false.
+	template<typename Rep, typename Period>
+	bool dequeue_for(T& t, std::chrono::duration<Rep, Period> const& timeout) {
+		return dequeue_until(t, std::chrono::steady_clock::now() + timeout);
+	}
+	/// @brief 	Dequeues an event.
+	///		If this queue is empty, this method waits a new event until the deadline.
+	/// @param[in]	t			Next event.
+	/// @param[in]	deadline	Deadline.
+	/// @return	It returns true if dequeued; otherwise, it returns false.
+	template<typename Clock, typename Duration>
+	bool dequeue_until(T& t, std::chrono::time_point<Clock, Duration> const& deadline) {
+		auto const until = std::chrono::steady_clock::now() + std::chrono::ceil<std::chrono::steady_clock::duration>(deadline - Clock::now());
+
+		std::unique_lock lock{mutex_};
+		if (! wait_(lock, &until) || finished_) return false;
+		pop_(t);
+		return true;
+	}
+	/// @brief 	Dequeues an event if this queue is not empty.
 	/// @param[in]	t	Next event.
+	/// @return	It returns true if dequeued; otherwise, it returns false.
+	bool try_dequeue(T& t) {
+		std::lock_guard lock{mutex_};
+		if (finished_ || queue_.empty()) return false;
+		pop_(t);
+		return true;
+	}
+	/// @brief 	Dequeues an event if this queue is not empty.
+	/// @return	Next event, or nullopt if this queue is empty or terminated.
+	std::optional<T> try_dequeue() {
+		std::lock_guard lock{mutex_};
+		if (finished_ || queue_.empty()) return std::nullopt;
+		std::optional<T> t{std::move(queue_.front())};	  // might cause an exception.
+		queue_.pop_front();
+		count_.store(queue_.size(), std::memory_order_relaxed);
+		counters_.popped(1u);
+		return t;
+	}
+	/// @brief 	Dequeues events at once.
+	///		If this queue is empty, this method waits a new event.
+	/// @param[out]	out		Output iterator to store the events.
+	/// @param[in]	max		The maximum number of events to dequeue.
+	/// @return	The number of dequeued events, or zero if terminated.
+	template<std::output_iterator<T&&> O>
+	std::size_t dequeue_bulk(O out, std::size_t max) {
+		if (max == 0u) return 0u;
+		std::unique_lock lock{mutex_};
+		wait_(lock, nullptr);
+		if (finished_) return 0u;
+		return take_(out, max);
+	}
+	/// @brief 	Dequeues events at once if this queue is not empty.
+	/// @param[out]	out		Output iterator to store the events.
+	/// @param[in]	max		The maximum number of events to dequeue.
+	/// @return	The number of dequeued events.
+	template<std::output_iterator<T&&> O>
+	std::size_t try_dequeue_bulk(O out, std::size_t max) {
+		std::lock_guard lock{mutex_};
+		if (finished_) return 0u;
+		return take_(out, max);
+	}
+	/// @brief 	Dequeues all the events at once.
+	///		If this queue is empty, this method waits a new event.
+	///		If the @p container is an empty container_type, the events are swapped out without moving each.
+	/// @param[in,out]	container	Container to append the events.
+	/// @return	It returns true if dequeued; otherwise, it returns false.
+	template<typename C>
+	bool drain(C& container) {
+		std::unique_lock lock{mutex_};
+		wait_(lock, nullptr);
+		if (finished_) return false;
+		auto const n = queue_.size();
+		if constexpr (std::is_same_v<C, container_type>) {
+			if (container.empty()) {
+				// The container takes over the pool, too, and gives it back when it frees its blocks.
+				container.swap(queue_);
+				container_type{allocator_type{container.get_allocator().pool()}}.swap(queue_);
+				count_.store(0u, std::memory_order_relaxed);
+				counters_.popped(n);
+				return true;
+			}
+		}
+		container.insert(container.end(), std::make_move_iterator(queue_.begin()), std::make_move_iterator(queue_.end()));	   // might cause an exception.
+		queue_.clear();
+		count_.store(0u, std::memory_order_relaxed);
+		counters_.popped(n);
+		return true;
+	}
+	/// @brief 	Terminates this queue.
+	///		Waiting consumers return false, and the events left are discarded.
 	void terminate() noexcept {
 		std::lock_guard lock{mutex_};
-		finished_ = true;
+		finished_.store(true);
 		queue_.clear();
+		count_.store(0u, std::memory_order_relaxed);
+		counters_.clear();
+		signal_.fetch_add(1u);
+		signal_.notify_all();
 		condition_.notify_all();
+		for (auto* listener: listeners_) listener->notify();
 	}
 	/// @brief 	Is this queue empty?
 	/// @return		It returns true if the queue is empty; otherwise, it returns false.
@@ -72,19 +487,143 @@ public:
 	}
 	/// @brief 	Is this queue terminated?
 	/// @return		It returns true if the queue has been terminated; otherwise, it returns false.
-	bool terminated() const noexcept { return finished_; }
+	bool terminated() const noexcept { return finished_.load(); }
+	/// @brief 	Sets how long consumers busy-wait before parking.
+	///		Busy-waiting reduces latency to wake consumers up at the cost of CPU time.
+	/// @param[in]	spins	The number of spins with a pause instruction.
+	/// @param[in]	yields	The number of yields of the thread after spinning.
+	void set_spin(std::size_t spins, std::size_t yields) noexcept {
+		std::lock_guard lock{mutex_};
+		spins_	= spins;
+		yields_ = yields;
+	}
+	/// @brief 	Gets a snapshot of the statistics.
+	///		It is available only if the queue is instrumented.
+	/// @return		Statistics.
+	queue_statistics_t statistics() const requires Instrumented {
+		std::lock_guard lock{mutex_};
+		return counters_.statistics(queue_.size());
+	}
 
 	/// @brief 	Constructor.
+	///		Like the std::deque, which allocates its map on construction, it terminates if the pool fails to be allocated.
 	queue() noexcept :
-		mutex_{}, queue_{}, condition_{}, finished_{} {}
+		mutex_{}, queue_{allocator_type{std::make_shared<impl::block_pool_t>()}}, condition_{}, count_{}, signal_{}, waiters_{}, timed_waiters_{}, spins_{}, yields_{}, counters_{}, listeners_{}, finished_{} {}
 	/// @brief 	Destructor.
 	~queue() noexcept { terminate(); }
 
 private:
-	mutable std::mutex		mutex_;		   ///< Mutex.
-	std::deque<T>			queue_;		   ///< Queue.
-	std::condition_variable condition_;	   ///< Condition to wait.
-	bool					finished_;	   ///< Finished flag.
+	friend class queue_selector_t;
+
+	// Waits until this queue has an event or is terminated.
+	// It returns false if timed out.
+	bool wait_(std::unique_lock<std::mutex>& lock, std::chrono::steady_clock::time_point const* deadline) {
+		if (! queue_.empty() || finished_) return true;
+		if constexpr (Instrumented) {
+			auto const since = std::chrono::steady_clock::now();
+			auto const ready = park_(lock, deadline);
+			counters_.blocked(std::chrono::steady_clock::now() - since);
+			return ready;
+		} else {
+			return park_(lock, deadline);
+		}
+	}
+	// Busy-waits and parks until this queue has an event or is terminated.
+	// It returns false if timed out.
+	bool park_(std::unique_lock<std::mutex>& lock, std::chrono::steady_clock::time_point const* deadline) {
+		// Busy-waits once without the lock.
+		if (auto const spins = spins_, total = spins_ + yields_; 0u < total) {
+			lock.unlock();
+			for (std::size_t i{}; i < total && count_.load(std::memory_order_relaxed) == 0u && ! finished_.load(std::memory_order_relaxed); ++i) {
+				if (i < spins) {
+					impl::pause();
+				} else {
+					if (deadline && *deadline <= std::chrono::steady_clock::now()) break;
+					std::this_thread::yield();
+				}
+			}
+			lock.lock();
+		}
+
+		// Parks.
+		while (queue_.empty() && ! finished_) {
+			if (deadline) {
+				// Only the condition variable can wait with a timeout.
+				++timed_waiters_;
+				auto const status = condition_.wait_until(lock, *deadline);
+				--timed_waiters_;
+				if (status == std::cv_status::timeout) return ! queue_.empty() || finished_;
+			} else {
+				// The signal_ is updated under the lock, so that the value loaded here is never stale.
+				auto const signal = signal_.load(std::memory_order_relaxed);
+				++waiters_;
+				lock.unlock();
+				signal_.wait(signal);
+				lock.lock();
+				--waiters_;
+			}
+		}
+		return true;
+	}
+	// Counts the events pushed after the size, and notifies waiting consumers of them under the lock.
+	void pushed_(std::size_t size) {
+		if constexpr (Instrumented) {
+			try {
+				counters_.pushed(queue_.size() - size, queue_.size());
+			} catch (...) {
+				while (size < queue_.size()) queue_.pop_back();
+				throw;
+			}
+		}
+		if (size < queue_.size()) {
+			notify_(size + 1u < queue_.size());
+			if (size == 0u) {
+				for (auto* listener: listeners_) listener->notify();
+			}
+		}
+	}
+	// Notifies waiting consumers of new events under the lock.
+	void notify_(bool all) noexcept {
+		count_.store(queue_.size(), std::memory_order_relaxed);
+		if (0u < waiters_) {
+			signal_.fetch_add(1u, std::memory_order_relaxed);
+			all ? signal_.notify_all() : signal_.notify_one();
+		}
+		if (0u < timed_waiters_) {
+			all ? condition_.notify_all() : condition_.notify_one();
+		}
+	}
+	// Pops events from the front under the lock.
+	template<typename O>
+	std::size_t take_(O out, std::size_t max) {
+		auto const n	= std::min(max, queue_.size());
+		auto const last = queue_.begin() + static_cast<typename container_type::difference_type>(n);
+		std::move(queue_.begin(), last, out);	 // might cause an exception.
+		queue_.erase(queue_.begin(), last);
+		count_.store(queue_.size(), std::memory_order_relaxed);
+		counters_.popped(n);
+		return n;
+	}
+	// Pops the front event under the lock.
+	void pop_(T& t) {
+		t = std::move(queue_.front());	  // might cause an exception.
+		queue_.pop_front();
+		count_.store(queue_.size(), std::memory_order_relaxed);
+		counters_.popped(1u);
+	}
+
+	mutable std::mutex		   mutex_;			 ///< Mutex.
+	container_type			   queue_;			 ///< Queue.
+	std::condition_variable	   condition_;		 ///< Condition for consumers to wait with a timeout.
+	std::atomic<std::size_t>   count_;			 ///< The number of events, which consumers spin on.
+	std::atomic<std::uint32_t> signal_;			 ///< Epoch for consumers to wait without any timeout.
+	std::size_t				   waiters_;		 ///< The number of consumers waiting the signal_.
+	std::size_t				   timed_waiters_;	 ///< The number of consumers waiting the condition_.
+	std::size_t				   spins_;			 ///< The number of spins before parking.
+	std::size_t				   yields_;			 ///< The number of yields before parking.
+	[[no_unique_address]] impl::queue_counters_t<Instrumented> counters_;	 ///< Counters for statistics.
+	std::vector<impl::queue_listener_t*> listeners_;	 ///< Listeners notified when this queue gets an event.
+	std::atomic<bool>		   finished_;		 ///< Finished flag.
 };
 
 }	 // namespace xxx
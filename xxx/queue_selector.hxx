@@ -0,0 +1,137 @@
+///	@file
+///	@brief		xxx common library.
+///	@details	Selector which waits for any of event queues.
+///	@pre		ISO/IEC 14882:2020 or higher
+///	@author		Mura
+///	@copyright	(C) 2023-, Mura. All rights reserved. (MIT License)
+
+#ifndef xxx_QUEUE_SELECTOR_HXX_
+#define xxx_QUEUE_SELECTOR_HXX_
+
+#include <xxx/queue.hxx>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace xxx {
+
+///	@brief	Selector which waits until any of event queues has an event.
+///		A consumer dequeues events from multiple queues directly, without any thread to forward them to a single queue.
+///		It returns the index of the queue ready, and the consumer dequeues events from the queue.
+///		If multiple queues are ready, it returns the one with the highest priority,
+///		and it returns the queues with the same priority in turn.
+///		Terminated queues are never ready.
+///		The queues have to outlive the selector, and a thread at a time can select queues.
+class queue_selector_t {
+public:
+	///	@brief	Adds a queue.
+	///	@param[in]	queue		The queue.
+	///	@param[in]	priority	Priority of the queue; the greater, the higher.
+	///	@return		Index of the queue, which is the number of queues added before.
+	template<typename T, bool Instrumented>
+	std::size_t add(queue<T, Instrumented>& queue, int priority = 0) {
+		entries_.reserve(entries_.size() + 1u);
+		{
+			std::lock_guard lock{queue.mutex_};
+			queue.listeners_.push_back(&listener_);
+		}
+		entries_.push_back(entry_t{&queue, &queue.count_, &queue.finished_, priority, [](void* p, impl::queue_listener_t* listener) noexcept {
+									   auto& queue = *static_cast<xxx::queue<T, Instrumented>*>(p);
+									   std::lock_guard lock{queue.mutex_};
+									   std::erase(queue.listeners_, listener);
+								   }});
+		return entries_.size() - 1u;
+	}
+	///	@brief	Waits until any of the queues has an event.
+	///	@return		Index of the queue ready, or nullopt if all the queues are terminated.
+	std::optional<std::size_t> select() { return select_(nullptr); }
+	///	@brief	Waits until any of the queues has an event or the timeout.
+	///	@param[in]	timeout	Timeout.
+	///	@return		Index of the queue ready, or nullopt if timed out or all the queues are terminated.
+	template<typename Rep, typename Period>
+	std::optional<std::size_t> select_for(std::chrono::duration<Rep, Period> const& timeout) {
+		return select_until(std::chrono::steady_clock::now() + timeout);
+	}
+	///	@brief	Waits until any of the queues has an event or the deadline.
+	///	@param[in]	deadline	Deadline.
+	///	@return		Index of the queue ready, or nullopt if timed out or all the queues are terminated.
+	template<typename Clock, typename Duration>
+	std::optional<std::size_t> select_until(std::chrono::time_point<Clock, Duration> const& deadline) {
+		auto const until = std::chrono::steady_clock::now() + std::chrono::ceil<std::chrono::steady_clock::duration>(deadline - Clock::now());
+		return select_(&until);
+	}
+	///	@brief	Gets the queue ready without waiting.
+	///	@return		Index of the queue ready, or nullopt if no queue is ready.
+	std::optional<std::size_t> try_select() { return find_().first; }
+	///	@brief	Gets the number of queues.
+	///	@return		The number of queues.
+	std::size_t size() const noexcept { return entries_.size(); }
+
+	///	@brief	Constructor.
+	queue_selector_t() :
+		listener_{}, entries_{}, next_{} {}
+	///	@brief	Destructor.
+	~queue_selector_t() noexcept {
+		for (auto const& entry: entries_) entry.detach(entry.queue, &listener_);
+	}
+
+private:
+	queue_selector_t(queue_selector_t const&)			 = delete;
+	queue_selector_t& operator=(queue_selector_t const&) = delete;
+
+	///	@brief	Queue to select.
+	struct entry_t {
+		void*							queue;		 ///< The queue.
+		std::atomic<std::size_t> const* count;		 ///< The number of events in the queue.
+		std::atomic<bool> const*		finished;	 ///< Finished flag of the queue.
+		int								priority;	 ///< Priority.
+		void (*detach)(void*, impl::queue_listener_t*) noexcept;	///< Function to remove the listener from the queue.
+	};
+
+	// Waits until any of the queues is ready or all of them are terminated.
+	// It returns nullopt if timed out.
+	std::optional<std::size_t> select_(std::chrono::steady_clock::time_point const* deadline) {
+		// Queues notify the listener under its lock, so that it never misses a notification while it is checking them.
+		std::unique_lock lock{listener_.mutex};
+		for (;;) {
+			auto const [ready, alive] = find_();
+			if (ready || ! alive) return ready;
+			if (deadline) {
+				if (listener_.condition.wait_until(lock, *deadline) == std::cv_status::timeout) return find_().first;
+			} else {
+				listener_.condition.wait(lock);
+			}
+		}
+	}
+	// Finds the queue ready with the highest priority, starting from the next one to the last.
+	// It also returns whether any queue is not terminated.
+	std::pair<std::optional<std::size_t>, bool> find_() noexcept {
+		std::optional<std::size_t> ready;
+		auto					   alive = false;
+		for (std::size_t k{}; k < entries_.size(); ++k) {
+			auto const	i	  = (next_ + k) % entries_.size();
+			auto const& entry = entries_[i];
+			if (entry.finished->load()) continue;
+			alive = true;
+			if (entry.count->load(std::memory_order_relaxed) == 0u) continue;
+			if (! ready || entries_[*ready].priority < entry.priority) ready = i;
+		}
+		if (ready) next_ = *ready + 1u;
+		return {ready, alive};
+	}
+
+	impl::queue_listener_t listener_;	///< Listener notified by the queues.
+	std::vector<entry_t>   entries_;	///< Queues.
+	std::size_t			   next_;		///< Index of the queue to check first.
+};
+
+}	 // namespace xxx
+
+#endif	  // xxx_QUEUE_SELECTOR_HXX_
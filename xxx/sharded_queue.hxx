@@ -0,0 +1,155 @@
+///	@file
+///	@brief		xxx common library.
+///	@details	Event queue sharded into lanes.
+///	@pre		ISO/IEC 14882:2020 or higher
+///	@author		Mura
+///	@copyright	(C) 2023-, Mura. All rights reserved. (MIT License)
+
+#ifndef xxx_SHARDED_QUEUE_HXX_
+#define xxx_SHARDED_QUEUE_HXX_
+
+#include <xxx/queue.hxx>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace xxx {
+
+///	@brief	Policies to choose a lane.
+enum class sharding_t {
+	Affinity,	  ///< Each thread uses its own lane.
+	RoundRobin	  ///< Each event goes to the next lane.
+};
+
+namespace impl {
+
+///	@brief	Gets the serial number of the current thread.
+///	@return		The serial number.
+inline std::size_t thread_index() noexcept {
+	static std::atomic<std::size_t> next_s{};
+	thread_local std::size_t const	index_s{next_s.fetch_add(1u, std::memory_order_relaxed)};
+	return index_s;
+}
+
+}	 // namespace impl
+
+///	@brief	Event queue sharded into lanes of xxx::queue.
+///		Producers spread events over the lanes so that they rarely contend on the same lock,
+///		and they touch no shared variable but the number of waiting consumers.
+///		Consumers take events from their own lane first, and steal from the other lanes when it is empty.
+///		The enqueue(), dequeue() and terminate() behave the same as the xxx::queue,
+///		except that events are first-in first-out only within a lane.
+template<typename T>
+class sharded_queue {
+public:
+	/// @brief 	Enqueues an event.
+	/// @param[in]	t	The event to push.
+	/// @return	It returns true if queued; otherwise, it returns false.
+	bool enqueue(T const& t) { return push_(t); }
+	/// @brief 	Enqueues an event.
+	/// @param[in]	t	The event to push.
+	/// @return	It returns true if queued; otherwise, it returns false.
+	bool enqueue(T&& t) { return push_(std::move(t)); }
+	/// @brief 	Dequeues an event.
+	///		If this queue is empty, this method waits a new event.
+	/// @param[in]	t	Next event.
+	/// @return	It returns true if dequeued; otherwise, it returns false.
+	bool dequeue(T& t) {
+		for (;;) {
+			if (terminated()) return false;
+			if (try_dequeue(t)) return true;
+
+			// Registers as a waiter before checking the queue again,
+			// so that a producer surely sees the waiter or this consumer surely sees the event.
+			auto const signal = signal_.load();
+			waiters_.fetch_add(1u);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (empty() && ! terminated()) {
+				signal_.wait(signal);
+			}
+			waiters_.fetch_sub(1u);
+		}
+	}
+	/// @brief 	Dequeues an event if this queue is not empty.
+	/// @param[in]	t	Next event.
+	/// @return	It returns true if dequeued; otherwise, it returns false.
+	bool try_dequeue(T& t) {
+		auto const home = impl::thread_index();
+		for (std::size_t i{}; i < size_; ++i) {
+			if (lanes_[(home + i) % size_].events.try_dequeue(t)) return true;
+		}
+		return false;
+	}
+	/// @brief 	Terminates this queue.
+	///		Waiting consumers return false, and the events left are discarded.
+	void terminate() noexcept {
+		finished_.store(true);
+		for (std::size_t i{}; i < size_; ++i) {
+			lanes_[i].events.terminate();
+		}
+		signal_.fetch_add(1u);
+		signal_.notify_all();
+	}
+	/// @brief 	Is this queue empty?
+	/// @return		It returns true if the queue is empty; otherwise, it returns false.
+	bool empty() const noexcept {
+		for (std::size_t i{}; i < size_; ++i) {
+			if (! lanes_[i].events.empty()) return false;
+		}
+		return true;
+	}
+	/// @brief 	Is this queue terminated?
+	/// @return		It returns true if the queue has been terminated; otherwise, it returns false.
+	bool terminated() const noexcept { return finished_.load(); }
+	/// @brief 	Gets the number of lanes.
+	/// @return		The number of lanes.
+	std::size_t lanes() const noexcept { return size_; }
+
+	/// @brief 	Constructor.
+	/// @param[in]	lanes		The number of lanes, or zero to use the number of hardware threads.
+	/// @param[in]	sharding	Policy to choose a lane.
+	explicit sharded_queue(std::size_t lanes = 0u, sharding_t sharding = sharding_t::Affinity) :
+		size_{0u < lanes ? lanes : std::max(std::size_t{1u}, std::size_t{std::thread::hardware_concurrency()})}, lanes_{std::make_unique<lane_t[]>(size_)}, sharding_{sharding}, next_{}, signal_{}, waiters_{}, finished_{} {}
+	/// @brief 	Destructor.
+	~sharded_queue() noexcept { terminate(); }
+
+private:
+	sharded_queue(sharded_queue const&)			   = delete;
+	sharded_queue& operator=(sharded_queue const&) = delete;
+
+	///	@brief	Lane.
+	struct alignas(cache_line_size) lane_t {
+		queue<T> events;	///< Events.
+	};
+
+	template<typename U>
+	bool push_(U&& u) {
+		auto const lane = sharding_ == sharding_t::Affinity ? impl::thread_index() : next_.fetch_add(1u, std::memory_order_relaxed);
+		if (! lanes_[lane % size_].events.enqueue(std::forward<U>(u))) return false;
+
+		// Pairs with the fence of the waiter.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (0u < waiters_.load(std::memory_order_relaxed)) {
+			signal_.fetch_add(1u);
+			signal_.notify_one();
+		}
+		return true;
+	}
+
+	std::size_t const								  size_;		///< The number of lanes.
+	std::unique_ptr<lane_t[]>						  lanes_;		///< Lanes.
+	sharding_t const								  sharding_;	///< Policy to choose a lane.
+	alignas(cache_line_size) std::atomic<std::size_t> next_;		///< Next lane for the round-robin policy.
+	alignas(cache_line_size) std::atomic<std::uint32_t> signal_;	///< Epoch for consumers to wait.
+	std::atomic<std::uint32_t>						  waiters_;		///< The number of waiting consumers.
+	std::atomic<bool>								  finished_;	///< Finished flag.
+};
+
+}	 // namespace xxx
+
+#endif	  // xxx_SHARDED_QUEUE_HXX_
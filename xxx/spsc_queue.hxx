@@ -0,0 +1,244 @@
+///	@file
+///	@brief		xxx common library.
+///	@details	Bounded wait-free queue for a single producer and a single consumer.
+///	@pre		ISO/IEC 14882:2020 or higher
+///	@author		Mura
+///	@copyright	(C) 2023-, Mura. All rights reserved. (MIT License)
+
+#ifndef xxx_SPSC_QUEUE_HXX_
+#define xxx_SPSC_QUEUE_HXX_
+
+#include <xxx/queue.hxx>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace xxx {
+
+///	@brief	Bounded event queue for a single producer and a single consumer.
+///		Only one thread may enqueue and only one thread may dequeue at the same time.
+///		Each side owns its position and caches the other's one,
+///		so that it reads the other's cache line only when the cache says it is full or empty,
+///		and it never uses atomic read-modify-write operations.
+template<typename T>
+class spsc_queue {
+	static_assert(std::is_nothrow_destructible_v<T>);
+
+public:
+	/// @brief 	Enqueues an event if this queue is not full.
+	///		Only the producer can call it.
+	/// @param[in]	t	The event to push.
+	/// @return	It returns true if queued; otherwise, it returns false.
+	bool try_enqueue(T const& t) { return try_emplace(t); }
+	/// @brief 	Enqueues an event if this queue is not full.
+	///		Only the producer can call it.
+	/// @param[in]	t	The event to push.
+	/// @return	It returns true if queued; otherwise, it returns false.
+	bool try_enqueue(T&& t) { return try_emplace(std::move(t)); }
+	/// @brief 	Constructs an event in place if this queue is not full.
+	///		Only the producer can call it.
+	/// @param[in]	args	Arguments to construct the event.
+	/// @return	It returns true if queued; otherwise, it returns false.
+	template<typename... Args>
+	bool try_emplace(Args&&... args) {
+		auto const head = head_.load(std::memory_order_relaxed);
+		if (head - tail_cache_ == capacity()) {
+			tail_cache_ = tail_.load(std::memory_order_acquire);
+			if (head - tail_cache_ == capacity()) return false;	   // full
+		}
+		::new (static_cast<void*>(&slots_[head & mask_])) T(std::forward<Args>(args)...);	   // might cause an exception.
+		head_.store(head + 1u, std::memory_order_release);
+		return true;
+	}
+	/// @brief 	Dequeues an event if this queue is not empty.
+	///		Only the consumer can call it.
+	/// @param[in]	t	Next event.
+	/// @return	It returns true if dequeued; otherwise, it returns false.
+	bool try_dequeue(T& t) {
+		auto const tail = tail_.load(std::memory_order_relaxed);
+		if (tail == head_cache_) {
+			head_cache_ = head_.load(std::memory_order_acquire);
+			if (tail == head_cache_) return false;	  // empty
+		}
+		auto* const e = get_(tail);
+		{
+			// Releases the slot even if the assignment throws an exception.
+			struct release_t {
+				T* const				  e;
+				std::atomic<std::size_t>& tail;
+				std::size_t const		  next;
+				~release_t() {
+					e->~T();
+					tail.store(next, std::memory_order_release);
+				}
+			} const release{e, tail_, tail + 1u};
+			t = std::move(*e);
+		}
+		return true;
+	}
+	/// @brief 	Is this queue empty?
+	/// @return		It returns true if the queue is empty; otherwise, it returns false.
+	bool empty() const noexcept { return size() == 0u; }
+	/// @brief 	Gets the number of events.
+	///		It is just a snapshot while the other thread is enqueuing or dequeuing events.
+	/// @return		The number of events.
+	std::size_t size() const noexcept {
+		auto const tail = tail_.load(std::memory_order_acquire);
+		auto const head = head_.load(std::memory_order_acquire);
+		return head - tail;
+	}
+	/// @brief 	Gets the capacity.
+	/// @return		The maximum number of events.
+	std::size_t capacity() const noexcept { return mask_ + 1u; }
+
+	/// @brief 	Constructor.
+	/// @param[in]	capacity	The maximum number of events, which is rounded up to a power of two.
+	explicit spsc_queue(std::size_t capacity) :
+		mask_{std::bit_ceil(std::max(capacity, std::size_t{1u})) - 1u}, slots_{std::make_unique<slot_t[]>(mask_ + 1u)}, head_{}, tail_cache_{}, tail_{}, head_cache_{} {}
+	/// @brief 	Destructor.
+	~spsc_queue() noexcept {
+		for (auto i = tail_.load(); i != head_.load(); ++i) {
+			get_(i)->~T();
+		}
+	}
+
+private:
+	spsc_queue(spsc_queue const&)			 = delete;
+	spsc_queue& operator=(spsc_queue const&) = delete;
+
+	///	@brief	Slot of the ring buffer.
+	struct slot_t {
+		alignas(T) std::byte storage[sizeof(T)];	///< Storage of an event.
+	};
+
+	T* get_(std::size_t pos) noexcept { return std::launder(reinterpret_cast<T*>(slots_[pos & mask_].storage)); }
+
+	std::size_t const								  mask_;		  ///< Capacity - 1.
+	std::unique_ptr<slot_t[]>						  slots_;		  ///< Ring buffer.
+	alignas(cache_line_size) std::atomic<std::size_t> head_;		  ///< Position to enqueue, written by the producer.
+	std::size_t										  tail_cache_;	  ///< Cache of the tail_ for the producer.
+	alignas(cache_line_size) std::atomic<std::size_t> tail_;		  ///< Position to dequeue, written by the consumer.
+	std::size_t										  head_cache_;	  ///< Cache of the head_ for the consumer.
+};
+
+///	@brief	Bounded event queue for a single producer and a single consumer, which waits like the xxx::queue.
+///		The consumer parks only when the queue is actually empty and the producer notifies only when the consumer parks,
+///		so that both sides do nothing more than the spsc_queue while events flow.
+///		Similarly, the producer parks only when the queue is full.
+template<typename T>
+class blocking_spsc_queue {
+public:
+	/// @brief 	Enqueues an event.
+	///		If this queue is full, this method waits a room.
+	/// @param[in]	t	The event to push.
+	/// @return	It returns true if queued; otherwise, it returns false.
+	bool enqueue(T const& t) { return emplace(t); }
+	/// @brief 	Enqueues an event.
+	///		If this queue is full, this method waits a room.
+	/// @param[in]	t	The event to push.
+	/// @return	It returns true if queued; otherwise, it returns false.
+	bool enqueue(T&& t) { return emplace(std::move(t)); }
+	/// @brief 	Constructs an event in place.
+	///		If this queue is full, this method waits a room.
+	/// @param[in]	args	Arguments to construct the event.
+	/// @return	It returns true if queued; otherwise, it returns false.
+	template<typename... Args>
+	bool emplace(Args&&... args) {
+		for (;;) {
+			if (terminated()) return false;
+			if (queue_.try_emplace(std::forward<Args>(args)...)) {
+				wake_(consumer_);
+				return true;
+			}
+			park_(producer_, [this]() { return queue_.size() < queue_.capacity(); });
+		}
+	}
+	/// @brief 	Dequeues an event.
+	///		If this queue is empty, this method waits a new event.
+	/// @param[in]	t	Next event.
+	/// @return	It returns true if dequeued; otherwise, it returns false.
+	bool dequeue(T& t) {
+		for (;;) {
+			if (terminated()) return false;
+			if (queue_.try_dequeue(t)) {
+				wake_(producer_);
+				return true;
+			}
+			park_(consumer_, [this]() { return ! queue_.empty(); });
+		}
+	}
+	/// @brief 	Dequeues an event if this queue is not empty.
+	/// @param[in]	t	Next event.
+	/// @return	It returns true if dequeued; otherwise, it returns false.
+	bool try_dequeue(T& t) {
+		if (terminated() || ! queue_.try_dequeue(t)) return false;
+		wake_(producer_);
+		return true;
+	}
+	/// @brief 	Terminates this queue.
+	///		Waiting producer and consumer return false.
+	///		Unlike xxx::queue, events left are discarded by the destructor
+	///		because only the consumer can dequeue them.
+	void terminate() noexcept {
+		finished_.store(true);
+		for (auto* waiter: {&producer_, &consumer_}) {
+			waiter->signal.fetch_add(1u);
+			waiter->signal.notify_all();
+		}
+	}
+	/// @brief 	Is this queue empty?
+	/// @return		It returns true if the queue is empty; otherwise, it returns false.
+	bool empty() const noexcept { return queue_.empty(); }
+	/// @brief 	Is this queue terminated?
+	/// @return		It returns true if the queue has been terminated; otherwise, it returns false.
+	bool terminated() const noexcept { return finished_.load(std::memory_order_relaxed); }
+
+	/// @brief 	Constructor.
+	/// @param[in]	capacity	The maximum number of events, which is rounded up to a power of two.
+	explicit blocking_spsc_queue(std::size_t capacity) :
+		queue_{capacity}, producer_{}, consumer_{}, finished_{} {}
+	/// @brief 	Destructor.
+	~blocking_spsc_queue() noexcept { terminate(); }
+
+private:
+	///	@brief	Waiter on a side.
+	struct alignas(cache_line_size) waiter_t {
+		std::atomic<bool>		   parked;	  ///< Whether the side is parked.
+		std::atomic<std::uint32_t> signal;	  ///< Epoch to wait.
+	};
+
+	template<typename P>
+	void park_(waiter_t& waiter, P const& ready) {
+		auto const signal = waiter.signal.load();
+		waiter.parked.store(true);
+		// Pairs with the fence of the wake_(); either the other side sees this flag or this side sees the event or the room.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (! ready() && ! terminated()) {
+			waiter.signal.wait(signal);
+		}
+		waiter.parked.store(false, std::memory_order_relaxed);
+	}
+	static void wake_(waiter_t& waiter) noexcept {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (waiter.parked.load(std::memory_order_relaxed)) {
+			waiter.signal.fetch_add(1u);
+			waiter.signal.notify_one();
+		}
+	}
+
+	spsc_queue<T>	  queue_;		///< Queue.
+	waiter_t		  producer_;	///< Waiter of the producer.
+	waiter_t		  consumer_;	///< Waiter of the consumer.
+	std::atomic<bool> finished_;	///< Finished flag.
+};
+
+}	 // namespace xxx
+
+#endif	  // xxx_SPSC_QUEUE_HXX_